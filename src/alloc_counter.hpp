@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Counts every heap allocation of the program for the benchmarks. It replaces
+// all of the global operator new and delete, which a program may do once, so
+// include it from the translation unit with main only.
+
+namespace mp {
+
+inline std::atomic<std::uint64_t> gHeapAllocations{0};
+
+[[nodiscard]]
+inline std::uint64_t HeapAllocations() {
+  return gHeapAllocations.load(std::memory_order_relaxed);
+}
+
+namespace alloc_counter {
+
+// Null when out of memory. Everything comes from malloc or aligned_alloc, so
+// Release frees any of it.
+[[nodiscard]]
+inline void* TryAcquire(std::size_t size, const std::align_val_t align) {
+  gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+  const auto alignment = static_cast<std::size_t>(align);
+  if (size == 0) size = 1;
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) return std::malloc(size);
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(alignment,
+                            (size + alignment - 1) / alignment * alignment);
+}
+
+[[nodiscard]]
+inline void* Acquire(const std::size_t size, const std::align_val_t align) {
+  if (void* ptr = TryAcquire(size, align)) return ptr;
+  throw std::bad_alloc();
+}
+
+// Not inlined, so the compiler never sees a free of what new returned and
+// warns about mismatched allocation functions.
+[[gnu::noinline]] inline void Release(void* ptr) noexcept { std::free(ptr); }
+
+constexpr std::align_val_t kDefaultAlign{__STDCPP_DEFAULT_NEW_ALIGNMENT__};
+
+}  // namespace alloc_counter
+}  // namespace mp
+
+void* operator new(const std::size_t size) {
+  return mp::alloc_counter::Acquire(size, mp::alloc_counter::kDefaultAlign);
+}
+
+void* operator new[](const std::size_t size) {
+  return mp::alloc_counter::Acquire(size, mp::alloc_counter::kDefaultAlign);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t align) {
+  return mp::alloc_counter::Acquire(size, align);
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t align) {
+  return mp::alloc_counter::Acquire(size, align);
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept {
+  return mp::alloc_counter::TryAcquire(size, mp::alloc_counter::kDefaultAlign);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept {
+  return mp::alloc_counter::TryAcquire(size, mp::alloc_counter::kDefaultAlign);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+  return mp::alloc_counter::TryAcquire(size, align);
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+  return mp::alloc_counter::TryAcquire(size, align);
+}
+
+void operator delete(void* ptr) noexcept { mp::alloc_counter::Release(ptr); }
+
+void operator delete[](void* ptr) noexcept { mp::alloc_counter::Release(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  mp::alloc_counter::Release(ptr);
+}
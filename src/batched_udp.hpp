@@ -0,0 +1,175 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace mp {
+
+inline constexpr std::size_t kUdpBatchSize = 32;
+inline constexpr std::size_t kUdpMaxDatagram = 4096;
+
+struct UdpDatagram {
+  std::span<const std::uint8_t> data;
+  sockaddr_in from;
+  bool bIsTruncated;
+};
+
+// Receives up to kUdpBatchSize datagrams per recvmmsg and hands them out one
+// at a time. Buffers are allocated once per socket.
+class UdpReceiveBatch final {
+ public:
+  explicit UdpReceiveBatch(const int socket)
+      : socket_(socket), storage_(kUdpBatchSize * kUdpMaxDatagram) {
+    for (std::size_t i = 0; i < kUdpBatchSize; ++i) {
+      iovecs_[i] = {.iov_base = storage_.data() + i * kUdpMaxDatagram,
+                    .iov_len = kUdpMaxDatagram};
+    }
+  }
+
+  UdpReceiveBatch(const UdpReceiveBatch& other) = delete;
+  UdpReceiveBatch& operator=(const UdpReceiveBatch& other) = delete;
+
+  // 1 with `out` filled, 0 when the socket has nothing queued, -1 on error.
+  // `out.data` stays valid until the next call.
+  int Next(UdpDatagram& out) {
+    if (next_ == count_) {
+      const int received = Refill();
+      if (received <= 0) return received;
+    }
+    const mmsghdr& message = messages_[next_];
+    out = {
+        .data = {storage_.data() + next_ * kUdpMaxDatagram, message.msg_len},
+        .from = addresses_[next_],
+        .bIsTruncated = (message.msg_hdr.msg_flags & MSG_TRUNC) != 0,
+    };
+    ++next_;
+    return 1;
+  }
+
+  // Whether datagrams of the last batch are still to be read. The socket
+  // does not poll readable for them, so they wait until Next is called.
+  [[nodiscard]]
+  bool HasPending() const {
+    return next_ < count_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Syscalls() const {
+    return syscalls_;
+  }
+
+ private:
+  int Refill() {
+    for (std::size_t i = 0; i < kUdpBatchSize; ++i) {
+      messages_[i] = {};
+      messages_[i].msg_hdr.msg_name = &addresses_[i];
+      messages_[i].msg_hdr.msg_namelen = sizeof(addresses_[i]);
+      messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+      messages_[i].msg_hdr.msg_iovlen = 1;
+    }
+    ++syscalls_;
+    next_ = 0;
+    const int received =
+        recvmmsg(socket_, messages_, kUdpBatchSize, MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+      count_ = 0;
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    count_ = received;
+    return received;
+  }
+
+  int socket_;
+  std::vector<std::uint8_t> storage_;
+  iovec iovecs_[kUdpBatchSize]{};
+  sockaddr_in addresses_[kUdpBatchSize]{};
+  mmsghdr messages_[kUdpBatchSize]{};
+  int next_{0};
+  int count_{0};
+  std::uint64_t syscalls_{0};
+};
+
+// Collects outgoing datagrams and sends them with one sendmmsg per
+// kUdpBatchSize datagrams or per explicit Flush.
+class UdpSendBatch final {
+ public:
+  explicit UdpSendBatch(const int socket)
+      : socket_(socket), storage_(kUdpBatchSize * kUdpMaxDatagram) {}
+
+  UdpSendBatch(const UdpSendBatch& other) = delete;
+  UdpSendBatch& operator=(const UdpSendBatch& other) = delete;
+
+  // Copies the gathered buffers into the batch; returns the datagram size,
+  // or -1 if it does not fit into one datagram.
+  int Push(const sockaddr_in& to, const std::span<const iovec> buffers) {
+    if (count_ == kUdpBatchSize) Flush();
+
+    std::uint8_t* slot = storage_.data() + count_ * kUdpMaxDatagram;
+    std::size_t length = 0;
+    for (const iovec& buffer : buffers) {
+      if (length + buffer.iov_len > kUdpMaxDatagram) return -1;
+      std::memcpy(slot + length, buffer.iov_base, buffer.iov_len);
+      length += buffer.iov_len;
+    }
+    addresses_[count_] = to;
+    iovecs_[count_] = {.iov_base = slot, .iov_len = length};
+    ++count_;
+    return static_cast<int>(length);
+  }
+
+  // Sends everything queued. Datagrams the kernel refuses are dropped, as a
+  // lost UDP datagram would be.
+  void Flush() {
+    std::size_t sent = 0;
+    while (sent < count_) {
+      const std::size_t pending = count_ - sent;
+      for (std::size_t i = 0; i < pending; ++i) {
+        messages_[i] = {};
+        messages_[i].msg_hdr.msg_name = &addresses_[sent + i];
+        messages_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        messages_[i].msg_hdr.msg_iov = &iovecs_[sent + i];
+        messages_[i].msg_hdr.msg_iovlen = 1;
+      }
+      ++syscalls_;
+      const int result = sendmmsg(socket_, messages_,
+                                  static_cast<unsigned>(pending), MSG_NOSIGNAL);
+      if (result <= 0) {
+        if (result < 0 && errno == EINTR) continue;
+        // skip the datagram the kernel rejected and carry on
+        sent += 1;
+        continue;
+      }
+      sent += static_cast<std::size_t>(result);
+    }
+    count_ = 0;
+  }
+
+  [[nodiscard]]
+  std::size_t Pending() const {
+    return count_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Syscalls() const {
+    return syscalls_;
+  }
+
+ private:
+  int socket_;
+  std::vector<std::uint8_t> storage_;
+  iovec iovecs_[kUdpBatchSize]{};
+  sockaddr_in addresses_[kUdpBatchSize]{};
+  mmsghdr messages_[kUdpBatchSize]{};
+  std::size_t count_{0};
+  std::uint64_t syscalls_{0};
+};
+
+}  // namespace mp
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <optional>
+#include <random>
+
+#include "game_data.hpp"
+#include "net_common.hpp"
+#include "resting_snapshot.hpp"
+#include "transport.hpp"
+#include "world_hash.hpp"
+
+namespace mp {
+
+enum class BotInputMode : std::uint8_t {
+  Random,  // a new random direction, or standing still, every input
+  Script,  // circles at a per-bot phase, the same every run
+};
+
+struct BotTraffic {
+  std::uint64_t snapshots{0};
+  std::uint64_t bytesReceived{0};
+  std::uint64_t bytesSent{0};
+  std::uint64_t inputsSent{0};
+  std::uint64_t disconnects{0};
+  // hashed snapshots whose world did not hash to the carried value
+  std::uint64_t hashMismatches{0};
+};
+
+// Headless stand-in for the game client: waits for its player, then sends
+// PlayerInputUpdate at a fixed rate and decodes every snapshot, the same
+// work a real client does minus the drawing.
+class BotClient final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  BotClient(const BotClient& other) = delete;
+  BotClient& operator=(const BotClient& other) = delete;
+
+  BotClient(const std::uint32_t index, const BotInputMode mode,
+            const std::chrono::microseconds inputPeriod,
+            const std::uint64_t seed)
+      : index_(index),
+        mode_(mode),
+        inputPeriod_(inputPeriod),
+        rng_(seed ^ (std::uint64_t{index} * 0x9E3779B97F4A7C15ull)) {
+    packetHandler_.RegisterHandler<Player>(
+        PacketType::Connect, [this](const Player& player) {
+          player_ = player;
+          bHasJoined_ = true;
+        });
+    packetHandler_.RegisterHandler<TickedWorldState>(
+        PacketType::WorldState, [this](const TickedWorldState& snapshot) {
+          OnWorld(snapshot.world);
+          renderTick_ = snapshot.tick;
+        });
+    packetHandler_.RegisterHandler<HashedWorldState>(
+        PacketType::HashedWorldState, [this](const HashedWorldState& snapshot) {
+          if (HashWorld(snapshot.world) != snapshot.hash) {
+            traffic_.hashMismatches++;
+          }
+          OnWorld(snapshot.world);
+          renderTick_ = snapshot.tick;
+        });
+    packetHandler_.RegisterHandler<RestingWorldState>(
+        PacketType::RestingWorldState,
+        [this](const RestingWorldState& snapshot) {
+          OnWorld(snapshot.Merge(world_));
+          renderTick_ = snapshot.tick;
+        });
+  }
+
+  void Connect(Transport& transport, const std::string& host,
+               const std::uint16_t port) {
+    peer_ = transport.Connect(host, port, 2);
+  }
+
+  [[nodiscard]]
+  PeerId Peer() const {
+    return peer_;
+  }
+
+  [[nodiscard]]
+  bool HasJoined() const {
+    return bHasJoined_;
+  }
+
+  [[nodiscard]]
+  bool IsConnected() const {
+    return bIsConnected_;
+  }
+
+  // Newest input the server applied, as echoed by the last snapshot.
+  [[nodiscard]]
+  std::uint32_t AckedInput() const {
+    return ackedInput_;
+  }
+
+  [[nodiscard]]
+  const BotTraffic& Traffic() const {
+    return traffic_;
+  }
+
+  void OnEvent(const TransportEvent& event, const Clock::time_point now) {
+    switch (event.type) {
+      case TransportEventType::Connect:
+        bIsConnected_ = true;
+        // spread the first inputs over one period
+        nextInput_ = now + std::chrono::microseconds(
+                               std::uniform_int_distribution<std::int64_t>(
+                                   0, inputPeriod_.count())(rng_));
+        break;
+      case TransportEventType::Disconnect:
+        bIsConnected_ = false;
+        bHasJoined_ = false;
+        traffic_.disconnects++;
+        break;
+      case TransportEventType::Receive: {
+        traffic_.bytesReceived += event.data.size();
+        const bool bWasJoined = bHasJoined_;
+        HandlePacket(event.data, packetHandler_);
+        if (bWasJoined) traffic_.snapshots++;
+      } break;
+    }
+  }
+
+  // Sends an input if one is due.
+  void Update(Transport& transport, const Clock::time_point now) {
+    if (!bHasJoined_ || now < nextInput_) return;
+    nextInput_ += inputPeriod_;
+    if (nextInput_ < now) nextInput_ = now + inputPeriod_;
+    SendInput(transport, NextVelocity(now));
+  }
+
+  // Sends `velocity` right away; returns the input's sequence number.
+  std::uint32_t SendInput(Transport& transport, const Vector2 velocity) {
+    player_.transform.velocity = velocity;
+    player_.lastInputSequence++;
+    const std::string packet =
+        renderTick_ ? SerializePacket(PacketType::TaggedInputUpdate,
+                                      TaggedInput{player_, *renderTick_})
+                    : SerializePacket(PacketType::PlayerInputUpdate, player_);
+    transport.Send(peer_, AsBytes(packet), 1, kPacketUnreliable);
+    traffic_.bytesSent += packet.size();
+    traffic_.inputsSent++;
+    return player_.lastInputSequence;
+  }
+
+ private:
+  void OnWorld(const WorldState& world) {
+    world_ = world;
+    for (const Player& player : world_.players) {
+      if (player.id == player_.id) {
+        ackedInput_ = player.lastInputSequence;
+      }
+    }
+  }
+
+  Vector2 NextVelocity(const Clock::time_point now) {
+    if (mode_ == BotInputMode::Script) {
+      const double seconds =
+          std::chrono::duration<double>(now.time_since_epoch()).count();
+      const double angle = seconds + index_ * (std::numbers::pi / 8);
+      return {static_cast<float>(std::cos(angle)),
+              static_cast<float>(std::sin(angle))};
+    }
+    // the keyboard client only ever sends unit vectors or zero
+    const int direction = std::uniform_int_distribution<int>(0, 8)(rng_);
+    if (direction == 8) return {};
+    const double angle = direction * (std::numbers::pi / 4);
+    return {static_cast<float>(std::cos(angle)),
+            static_cast<float>(std::sin(angle))};
+  }
+
+  std::uint32_t index_;
+  BotInputMode mode_;
+  std::chrono::microseconds inputPeriod_;
+  std::mt19937_64 rng_;
+  PacketHandler packetHandler_;
+  PeerId peer_{kInvalidPeerId};
+  Player player_{};
+  WorldState world_;
+  // tick of the last snapshot, none before the first
+  std::optional<std::uint64_t> renderTick_;
+  std::uint32_t ackedInput_{0};
+  bool bIsConnected_{false};
+  bool bHasJoined_{false};
+  Clock::time_point nextInput_{};
+  BotTraffic traffic_;
+};
+
+}  // namespace mp
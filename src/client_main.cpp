@@ -1,9 +1,13 @@
 // clang-format off
+#include "enet_transport.hpp"
 #include "net_common.hpp"
 #include "game_data.hpp"
 #include "mpr_utility.hpp"
 #include "mpr_window.hpp"
+#include "rink.hpp"
 #include "connect_dialog.hpp"
+#include "resting_snapshot.hpp"
+#include "world_hash.hpp"
 
 #include <Windows.h>
 #include <gdiplus.h>
@@ -13,6 +17,7 @@
 #include <algorithm>
 #include <format>
 #include <iostream>
+#include <optional>
 
 // clang-format on
 
@@ -23,7 +28,8 @@ constexpr auto kWindowHeight{600};
 void DrawCircleObject(mp::Window& window, const auto& p,
                       const COLORREF c = RGB(255, 255, 255),
                       const COLORREF o = RGB(0, 0, 0)) {
-  window.DrawCircle(p.transform.radius, p.transform.pos, c, o);
+  window.DrawCircle(mp::ToFloat(p.transform.radius),
+                    mp::ToFloat(p.transform.pos), c, o);
 }
 
 }  // namespace
@@ -37,6 +43,8 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
 
   mp::PacketHandler packetHandler;
   mp::WorldState worldState;
+  // tick of the world on screen, from the last snapshot
+  std::optional<std::uint64_t> renderTick;
   std::uint32_t thisPlayerId{~0u};
   packetHandler.RegisterHandler<mp::Player>(
       mp::PacketType::Connect,
@@ -46,18 +54,40 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
         std::cout << "Handled connect packet, our player id: " << data.id
                   << " team id: " << data.teamId << "\n";
       });
-  packetHandler.RegisterHandler<mp::WorldState>(
+  packetHandler.RegisterHandler<mp::TickedWorldState>(
       mp::PacketType::WorldState,
-      [&worldState](const mp::WorldState& world) { worldState = world; });
+      [&worldState, &renderTick](const mp::TickedWorldState& snapshot) {
+        worldState = snapshot.world;
+        renderTick = snapshot.tick;
+      });
+  packetHandler.RegisterHandler<mp::HashedWorldState>(
+      mp::PacketType::HashedWorldState,
+      [&worldState, &renderTick](const mp::HashedWorldState& snapshot) {
+#ifndef NDEBUG
+        // the client only renders the server's world, so this catches
+        // snapshots that decode to something else than was sent
+        if (mp::HashWorld(snapshot.world) != snapshot.hash) {
+          std::cout << "Snapshot of tick " << snapshot.tick
+                    << " does not match its hash\n";
+        }
+#endif
+        worldState = snapshot.world;
+        renderTick = snapshot.tick;
+      });
+  packetHandler.RegisterHandler<mp::RestingWorldState>(
+      mp::PacketType::RestingWorldState,
+      [&worldState, &renderTick](const mp::RestingWorldState& snapshot) {
+        worldState = snapshot.Merge(worldState);
+        renderTick = snapshot.tick;
+      });
 
   mp::EnetInit();
   assert(0 == atexit(enet_deinitialize));
-  auto host = mp::EnetCreateHost(nullptr, 1, 2);
-  assert(host.get());
+  mp::EnetTransport transport(nullptr, 1, 2);
 
   bool bIsReady = false;
-  ENetEvent event;
-  ENetPeer* peer = nullptr;
+  mp::TransportEvent event;
+  mp::PeerId peer = mp::kInvalidPeerId;
   mp::ConnectionInfo connection;
   while (!bIsReady) {
     try {
@@ -65,15 +95,13 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
         return 0;
       }
       bIsReady = true;
-      const ENetAddress serverAddr =
-          mp::EnetCreateAddress(connection.port, connection.ip.c_str());
-      peer = enet_host_connect(host.get(), &serverAddr, 2, 0);
-      assert(peer);
-      if (enet_host_service(host.get(), &event, 5000) > 0 &&
-          event.type == ENET_EVENT_TYPE_CONNECT) {
+      peer = transport.Connect(connection.ip, connection.port, 2);
+      assert(peer != mp::kInvalidPeerId);
+      if (transport.Poll(event, 5000) &&
+          event.type == mp::TransportEventType::Connect) {
         MessageBoxA(nullptr, "Connection successful!", "Ok!", MB_OK);
       } else {
-        enet_peer_reset(peer);
+        transport.Reset(peer);
         MessageBoxA(nullptr, "Connection failed, try again!", "Ooops!", MB_OK);
         bIsReady = false;
       }
@@ -83,10 +111,9 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
     }
   }
 
-  if (enet_host_service(host.get(), &event, 5000) > 0 &&
-      event.type == ENET_EVENT_TYPE_RECEIVE) {
-    mp::HandlePacket(event.packet, packetHandler);
-    enet_packet_destroy(event.packet);
+  if (transport.Poll(event, 5000) &&
+      event.type == mp::TransportEventType::Receive) {
+    mp::HandlePacket(event.data, packetHandler);
     std::cout << "Got a required packet\n";
   } else {
     throw std::runtime_error("Unexpected packet type");
@@ -96,8 +123,14 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
   Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, nullptr);
 
   mp::Window window(hInstance, nShowCmd, kWindowWidth, kWindowHeight);
+  // the walls the sim collides with, its arcs as short edges
+  std::vector<std::array<mp::Vector2f, 2>> walls;
+  for (const auto& [start, end] : mp::DefaultRink<mp::Real>().Edges()) {
+    walls.push_back({mp::ToFloat(start), mp::ToFloat(end)});
+  }
   bool bIsRunning = true;
   bool bNeedToDisconnect = true;
+  std::uint32_t inputSequence = 0;
 
   MSG msg{};
   while (bIsRunning) {
@@ -134,26 +167,29 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
     }
     // Send Input to the server
     if (bHasPlayerModified) {
-      mp::SendPacket(peer, mp::PacketType::PlayerInputUpdate, currentPlayer, 0,
-                     1);
+      currentPlayer.lastInputSequence = ++inputSequence;
+      if (renderTick) {
+        mp::SendPacket(transport, peer, mp::PacketType::TaggedInputUpdate,
+                       mp::TaggedInput{currentPlayer, *renderTick},
+                       mp::kPacketUnreliable, 1);
+      } else {
+        mp::SendPacket(transport, peer, mp::PacketType::PlayerInputUpdate,
+                       currentPlayer, mp::kPacketUnreliable, 1);
+      }
     }
     // get world state
-    while (enet_host_service(host.get(), &event, 0) > 0) {
+    while (transport.Poll(event)) {
       switch (event.type) {
-        case ENET_EVENT_TYPE_NONE:
-          std::cout << "none\n";
-          break;
-        case ENET_EVENT_TYPE_CONNECT:
+        case mp::TransportEventType::Connect:
           std::cout << "connect from server\n";
           break;
-        case ENET_EVENT_TYPE_DISCONNECT:
+        case mp::TransportEventType::Disconnect:
           std::cout << "Server dropped its connection\n";
           bIsRunning = false;
           bNeedToDisconnect = false;
           break;
-        case ENET_EVENT_TYPE_RECEIVE:
-          mp::HandlePacket(event.packet, packetHandler);
-          enet_packet_destroy(event.packet);
+        case mp::TransportEventType::Receive:
+          mp::HandlePacket(event.data, packetHandler);
           break;
       }
     }
@@ -161,17 +197,18 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
     // draw
     window.Clear(RGB(34, 66, 99));
 
-    window.DrawLine(
-        {mp::WorldState::leftRightLines.x, mp::WorldState::teamsGoalsY.x},
-        {mp::WorldState::leftRightLines.y, mp::WorldState::teamsGoalsY.x},
-        RGB(0, 0, 255));
-    window.DrawLine(
-        {mp::WorldState::leftRightLines.x, mp::WorldState::teamsGoalsY.y},
-        {mp::WorldState::leftRightLines.y, mp::WorldState::teamsGoalsY.y},
-        RGB(255, 0, 0));
+    window.DrawLine(mp::ToFloat(mp::Vector2{mp::WorldState::leftRightLines.x,
+                                            mp::WorldState::teamsGoalsY.x}),
+                    mp::ToFloat(mp::Vector2{mp::WorldState::leftRightLines.y,
+                                            mp::WorldState::teamsGoalsY.x}),
+                    RGB(0, 0, 255));
+    window.DrawLine(mp::ToFloat(mp::Vector2{mp::WorldState::leftRightLines.x,
+                                            mp::WorldState::teamsGoalsY.y}),
+                    mp::ToFloat(mp::Vector2{mp::WorldState::leftRightLines.y,
+                                            mp::WorldState::teamsGoalsY.y}),
+                    RGB(255, 0, 0));
 
-    window.DrawField(mp::WorldState::fieldBorders[0],
-                     mp::WorldState::fieldBorders[1]);
+    window.DrawField(walls);
 
     for (const auto& player : worldState.players) {
       COLORREF fillColor;
@@ -201,13 +238,13 @@ int APIENTRY wWinMain(_In_ const HINSTANCE hInstance,
   // disconnect if server is alive, otherwise just exit
   if (bNeedToDisconnect) {
     std::cout << "Disconnecting\n";
-    mp::SendPacket(peer, mp::PacketType::Disconnect, thisPlayerId);
-    enet_host_flush(host.get());
-    enet_host_service(host.get(), &event, 5000);
-    enet_peer_disconnect(peer, 0);
-    do {
-      enet_host_service(host.get(), &event, 5000);
-    } while (event.type != ENET_EVENT_TYPE_DISCONNECT);
+    mp::SendPacket(transport, peer, mp::PacketType::Disconnect, thisPlayerId);
+    transport.Flush();
+    transport.Poll(event, 5000);
+    transport.Disconnect(peer);
+    while (transport.Poll(event, 5000) &&
+           event.type != mp::TransportEventType::Disconnect) {
+    }
   }
 
   return 0;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace mp {
+
+[[nodiscard]]
+constexpr std::uint64_t SplitMix64(std::uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Seed of room `room` of a server started with `serverSeed`.
+[[nodiscard]]
+constexpr std::uint64_t RoomSeed(const std::uint64_t serverSeed,
+                                 const std::uint64_t room) {
+  return SplitMix64(SplitMix64(serverSeed) ^ room);
+}
+
+// Counter-based generator: the n-th number of the stream for (seed, tick,
+// stream) is SplitMix64 of a key derived from the three plus n. Nothing is
+// shared between streams and nothing carries over from earlier ticks, so a
+// spawn drawn from it is a pure function of its inputs: rooms draw on their
+// own threads and replays re-derive spawns instead of storing them.
+class CounterRng {
+ public:
+  using result_type = std::uint64_t;
+
+  constexpr CounterRng(const std::uint64_t seed, const std::uint64_t tick,
+                       const std::uint64_t stream)
+      : key_(SplitMix64(SplitMix64(SplitMix64(seed) ^ tick) ^ stream)) {}
+
+  [[nodiscard]]
+  static constexpr result_type min() {
+    return 0;
+  }
+
+  [[nodiscard]]
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  constexpr result_type operator()() {
+    return SplitMix64(key_ + 0x9E3779B97F4A7C15ull * counter_++);
+  }
+
+  // Uniform in [low, high) from the top 53 bits of the next number, the same
+  // on every standard library, unlike std::uniform_real_distribution.
+  constexpr double Uniform(const double low, const double high) {
+    return low + (high - low) * static_cast<double>((*this)() >> 11) *
+                     0x1.0p-53;
+  }
+
+ private:
+  std::uint64_t key_;
+  std::uint64_t counter_{0};
+};
+
+}  // namespace mp
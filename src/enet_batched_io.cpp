@@ -0,0 +1,121 @@
+#include "enet_batched_io.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
+#include "batched_udp.hpp"
+#include "enet.h"
+
+// ENet's unix ENetBuffer mirrors iovec so buffers can go to the kernel as is.
+static_assert(sizeof(ENetBuffer) == sizeof(iovec));
+
+namespace {
+
+std::atomic<bool> bIsBatchingEnabled = false;
+
+struct SocketBatches {
+  explicit SocketBatches(const ENetSocket socket)
+      : receive(socket), send(socket) {}
+
+  mp::UdpReceiveBatch receive;
+  mp::UdpSendBatch send;
+};
+
+// Every host is serviced by a single thread, so batches are kept per thread.
+thread_local std::unordered_map<ENetSocket, std::unique_ptr<SocketBatches>>
+    socketBatches;
+
+SocketBatches& BatchesFor(const ENetSocket socket) {
+  auto& batches = socketBatches[socket];
+  if (!batches) batches = std::make_unique<SocketBatches>(socket);
+  return *batches;
+}
+
+}  // namespace
+
+namespace mp {
+
+void EnableBatchedEnetIo(const bool bIsEnabled) {
+  bIsBatchingEnabled = bIsEnabled;
+}
+
+void FlushBatchedEnetSends() {
+  for (auto& [socket, batches] : socketBatches) {
+    batches->send.Flush();
+  }
+}
+
+bool HasBatchedEnetReceives(const int socket) {
+  const auto it = socketBatches.find(socket);
+  return it != socketBatches.end() && it->second->receive.HasPending();
+}
+
+}  // namespace mp
+
+extern "C" {
+
+int __real_enet_socket_receive(ENetSocket, ENetAddress*, ENetBuffer*, size_t);
+int __real_enet_socket_send(ENetSocket, const ENetAddress*, const ENetBuffer*,
+                            size_t);
+void __real_enet_socket_destroy(ENetSocket);
+
+// Same contract as enet_socket_receive: datagram size, 0 when nothing is
+// queued, -1 on error and -2 for a datagram that did not fit.
+int __wrap_enet_socket_receive(const ENetSocket socket, ENetAddress* address,
+                               ENetBuffer* buffers, const size_t bufferCount) {
+  if (!bIsBatchingEnabled.load(std::memory_order_relaxed)) {
+    return __real_enet_socket_receive(socket, address, buffers, bufferCount);
+  }
+
+  mp::UdpDatagram datagram;
+  if (const int result = BatchesFor(socket).receive.Next(datagram);
+      result <= 0) {
+    return result;
+  }
+  if (datagram.bIsTruncated) return -2;
+
+  std::size_t copied = 0;
+  for (std::size_t i = 0; i < bufferCount && copied < datagram.data.size();
+       ++i) {
+    const std::size_t chunk =
+        std::min(buffers[i].dataLength, datagram.data.size() - copied);
+    std::memcpy(buffers[i].data, datagram.data.data() + copied, chunk);
+    copied += chunk;
+  }
+  if (copied < datagram.data.size()) return -2;
+
+  if (address) {
+    address->host = datagram.from.sin_addr.s_addr;
+    address->port = ENET_NET_TO_HOST_16(datagram.from.sin_port);
+  }
+  return static_cast<int>(copied);
+}
+
+int __wrap_enet_socket_send(const ENetSocket socket, const ENetAddress* address,
+                            const ENetBuffer* buffers,
+                            const size_t bufferCount) {
+  if (!bIsBatchingEnabled.load(std::memory_order_relaxed) || !address) {
+    return __real_enet_socket_send(socket, address, buffers, bufferCount);
+  }
+
+  sockaddr_in to{};
+  to.sin_family = AF_INET;
+  to.sin_port = ENET_HOST_TO_NET_16(address->port);
+  to.sin_addr.s_addr = address->host;
+  return BatchesFor(socket).send.Push(
+      to, {reinterpret_cast<const iovec*>(buffers), bufferCount});
+}
+
+void __wrap_enet_socket_destroy(const ENetSocket socket) {
+  // the descriptor number gets reused, so the batches must not outlive it
+  if (const auto it = socketBatches.find(socket); it != socketBatches.end()) {
+    it->second->send.Flush();
+    socketBatches.erase(it);
+  }
+  __real_enet_socket_destroy(socket);
+}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+namespace mp {
+
+// Batched UDP I/O for every ENet host in the process: ENet's per-datagram
+// socket calls are redirected (link-time --wrap, static ENet only) to
+// recvmmsg/sendmmsg batches. Off until enabled; without the link-time
+// support the calls below do nothing.
+#ifdef MP_HAS_BATCHED_ENET_IO
+inline constexpr bool kHasBatchedEnetIo = true;
+
+// Call before the first host is serviced.
+void EnableBatchedEnetIo(bool bIsEnabled);
+
+// Sends what ENet queued on the calling thread; call after every
+// enet_host_service or enet_host_flush.
+void FlushBatchedEnetSends();
+
+// Whether the calling thread's batch for `socket` holds datagrams ENet has
+// not read yet. A service reads at most 256, and the socket does not poll
+// readable for the rest, so service the host again until this is false.
+[[nodiscard]]
+bool HasBatchedEnetReceives(int socket);
+#else
+inline constexpr bool kHasBatchedEnetIo = false;
+
+inline void EnableBatchedEnetIo(bool) {}
+
+inline void FlushBatchedEnetSends() {}
+
+[[nodiscard]]
+inline bool HasBatchedEnetReceives(int) {
+  return false;
+}
+#endif
+
+}  // namespace mp
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "enet.h"
+#include "enet_batched_io.hpp"
+#include "transport.hpp"
+
+namespace mp {
+
+inline ENetAddress EnetCreateAddress(const std::uint16_t port,
+                                     const char* addr = "127.0.0.1") {
+  ENetAddress address{.port = port};
+  if (enet_address_set_host_ip(&address, addr) != 0) {
+    throw std::runtime_error("Incorrect ip or port");
+  }
+  return address;
+}
+
+inline void EnetInit() {
+  if (0 != enet_initialize()) {
+    throw std::runtime_error("Failed to init enet");
+  }
+}
+
+inline auto EnetCreateHost(const ENetAddress* address,
+                           const std::size_t numConnections,
+                           const std::size_t numChannels) {
+  static auto hostDeleter = [](ENetHost* host) { enet_host_destroy(host); };
+  return std::unique_ptr<ENetHost, decltype(hostDeleter)>{
+      enet_host_create(address, numConnections, numChannels, 0, 0)};
+}
+
+using EnetHostPtr = decltype(EnetCreateHost(nullptr, 0, 0));
+
+// Transport over a single ENet host. Peer ids are slots in the host's peer
+// array.
+class EnetTransport final : public Transport {
+ public:
+  EnetTransport(const EnetTransport& other) = delete;
+  EnetTransport& operator=(const EnetTransport& other) = delete;
+
+  explicit EnetTransport(EnetHostPtr host) : host_(std::move(host)) {
+    if (!host_) {
+      throw std::runtime_error("Failed to create enet host");
+    }
+  }
+
+  // `address` null: client side, no listening socket.
+  EnetTransport(const ENetAddress* address, const std::size_t peerCount,
+                const std::size_t channelCount)
+      : EnetTransport(EnetCreateHost(address, peerCount, channelCount)) {}
+
+  ~EnetTransport() override { ReleaseReceived(); }
+
+  PeerId Connect(const std::string& host, const std::uint16_t port,
+                 const std::size_t channelCount) override {
+    const ENetAddress address = EnetCreateAddress(port, host.c_str());
+    ENetPeer* peer = enet_host_connect(host_.get(), &address, channelCount, 0);
+    return peer ? IdOf(peer) : kInvalidPeerId;
+  }
+
+  void Send(const PeerId peer, const std::span<const std::uint8_t> data,
+            const std::uint8_t channel, const std::uint32_t flags) override {
+    enet_peer_send(&host_->peers[peer], channel, CreatePacket(data, flags));
+  }
+
+  void Broadcast(const std::span<const std::uint8_t> data,
+                 const std::uint8_t channel,
+                 const std::uint32_t flags) override {
+    enet_host_broadcast(host_.get(), channel, CreatePacket(data, flags));
+  }
+
+  bool Poll(TransportEvent& event,
+            const std::uint32_t timeoutMs = 0) override {
+    ReleaseReceived();
+    ENetEvent enetEvent;
+    int serviced = enet_host_service(host_.get(), &enetEvent, timeoutMs);
+#ifdef MP_HAS_BATCHED_ENET_IO
+    // datagrams a batch took off the socket but ENet did not get to yet
+    while (serviced == 0 && HasBatchedEnetReceives(host_->socket)) {
+      serviced = enet_host_service(host_.get(), &enetEvent, 0);
+    }
+#endif
+    if (serviced <= 0) {
+      // drained: whatever the service queued can leave now
+      FlushBatchedEnetSends();
+      return false;
+    }
+
+    event.peer = IdOf(enetEvent.peer);
+    event.channel = enetEvent.channelID;
+    event.flags = 0;
+    event.data = {};
+    switch (enetEvent.type) {
+      case ENET_EVENT_TYPE_CONNECT:
+        event.type = TransportEventType::Connect;
+        break;
+      case ENET_EVENT_TYPE_DISCONNECT:
+        event.type = TransportEventType::Disconnect;
+        break;
+      case ENET_EVENT_TYPE_RECEIVE:
+        event.type = TransportEventType::Receive;
+        received_ = enetEvent.packet;
+        event.flags = FlagsOf(received_);
+        event.data = {received_->data, received_->dataLength};
+        break;
+      case ENET_EVENT_TYPE_NONE:
+        return false;
+    }
+    return true;
+  }
+
+  void Flush() override {
+    enet_host_flush(host_.get());
+    FlushBatchedEnetSends();
+  }
+
+  void Disconnect(const PeerId peer) override {
+    enet_peer_disconnect(&host_->peers[peer], 0);
+  }
+
+  void Reset(const PeerId peer) override {
+    enet_peer_reset(&host_->peers[peer]);
+  }
+
+  // Round trip time ENet measured for the peer.
+  [[nodiscard]]
+  std::uint32_t RoundTripTimeMs(const PeerId peer) const {
+    return host_->peers[peer].roundTripTime;
+  }
+
+  // Socket to wait on in an external event loop.
+  [[nodiscard]]
+  ENetSocket NativeHandle() const {
+    return host_->socket;
+  }
+
+ private:
+  static ENetPacket* CreatePacket(const std::span<const std::uint8_t> data,
+                                  const std::uint32_t flags) {
+    std::uint32_t enetFlags = 0;
+    if (flags & kPacketReliable) enetFlags |= ENET_PACKET_FLAG_RELIABLE;
+    if (flags & kPacketUnsequenced) enetFlags |= ENET_PACKET_FLAG_UNSEQUENCED;
+    return enet_packet_create(data.data(), data.size(), enetFlags);
+  }
+
+  static std::uint32_t FlagsOf(const ENetPacket* packet) {
+    std::uint32_t flags = kPacketUnreliable;
+    if (packet->flags & ENET_PACKET_FLAG_RELIABLE) flags |= kPacketReliable;
+    if (packet->flags & ENET_PACKET_FLAG_UNSEQUENCED) {
+      flags |= kPacketUnsequenced;
+    }
+    return flags;
+  }
+
+  PeerId IdOf(const ENetPeer* peer) const {
+    return static_cast<PeerId>(peer - host_->peers);
+  }
+
+  void ReleaseReceived() {
+    if (received_) {
+      enet_packet_destroy(received_);
+      received_ = nullptr;
+    }
+  }
+
+  EnetHostPtr host_;
+  ENetPacket* received_{nullptr};
+};
+
+}  // namespace mp
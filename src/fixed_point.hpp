@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace mp {
+
+// Q16.16 fixed point for deterministic physics. Every operation is integer
+// arithmetic, so results are bit-identical across compilers, optimization
+// levels and cpus. Results saturate instead of overflowing, products and
+// quotients truncate toward zero (a velocity damped by 0.99 reaches zero
+// from either side) and division by zero saturates.
+class Fixed {
+ public:
+  using Raw = std::int32_t;
+  static constexpr int kFractionBits = 16;
+  static constexpr Raw kOne = Raw{1} << kFractionBits;
+
+  constexpr Fixed() = default;
+
+  // Implicit, so the literals in the sim read the same for float and Fixed;
+  // rounding a constant is exact integer math too.
+  template <typename T>
+    requires(std::is_arithmetic_v<T>)
+  constexpr Fixed(const T value)  // NOLINT(google-explicit-constructor)
+      : raw_(FromArithmetic(value)) {}
+
+  [[nodiscard]]
+  static constexpr Fixed FromRaw(const Raw raw) {
+    Fixed value;
+    value.raw_ = raw;
+    return value;
+  }
+
+  [[nodiscard]]
+  constexpr Raw RawValue() const {
+    return raw_;
+  }
+
+  [[nodiscard]]
+  constexpr float ToFloat() const {
+    return static_cast<float>(raw_) / static_cast<float>(kOne);
+  }
+
+  constexpr explicit operator float() const { return ToFloat(); }
+
+  constexpr explicit operator double() const {
+    return static_cast<double>(raw_) / kOne;
+  }
+
+  [[nodiscard]]
+  constexpr Fixed operator-() const {
+    return FromRaw(Saturate(-std::int64_t{raw_}));
+  }
+
+  constexpr Fixed& operator+=(const Fixed rhs) {
+    raw_ = Saturate(std::int64_t{raw_} + rhs.raw_);
+    return *this;
+  }
+
+  constexpr Fixed& operator-=(const Fixed rhs) {
+    raw_ = Saturate(std::int64_t{raw_} - rhs.raw_);
+    return *this;
+  }
+
+  constexpr Fixed& operator*=(const Fixed rhs) {
+    raw_ = Saturate(std::int64_t{raw_} * rhs.raw_ / kOne);
+    return *this;
+  }
+
+  constexpr Fixed& operator/=(const Fixed rhs) {
+    if (rhs.raw_ == 0) {
+      raw_ = raw_ == 0 ? 0
+             : raw_ > 0 ? std::numeric_limits<Raw>::max()
+                        : std::numeric_limits<Raw>::min();
+    } else {
+      raw_ = Saturate(std::int64_t{raw_} * kOne / rhs.raw_);
+    }
+    return *this;
+  }
+
+  friend constexpr Fixed operator+(Fixed lhs, const Fixed rhs) {
+    return lhs += rhs;
+  }
+
+  friend constexpr Fixed operator-(Fixed lhs, const Fixed rhs) {
+    return lhs -= rhs;
+  }
+
+  friend constexpr Fixed operator*(Fixed lhs, const Fixed rhs) {
+    return lhs *= rhs;
+  }
+
+  friend constexpr Fixed operator/(Fixed lhs, const Fixed rhs) {
+    return lhs /= rhs;
+  }
+
+  friend constexpr bool operator==(const Fixed& lhs,
+                                   const Fixed& rhs) = default;
+  friend constexpr auto operator<=>(const Fixed& lhs,
+                                    const Fixed& rhs) = default;
+
+  template <typename Archive>
+  void serialize(Archive& ar) {
+    ar(raw_);
+  }
+
+ private:
+  static constexpr Raw Saturate(const std::int64_t value) {
+    if (value > std::numeric_limits<Raw>::max()) {
+      return std::numeric_limits<Raw>::max();
+    }
+    if (value < std::numeric_limits<Raw>::min()) {
+      return std::numeric_limits<Raw>::min();
+    }
+    return static_cast<Raw>(value);
+  }
+
+  template <typename T>
+  static constexpr Raw FromArithmetic(const T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+      const double scaled = static_cast<double>(value) * kOne;
+      // round half away from zero, clamped before the cast
+      const double rounded = scaled < 0 ? scaled - 0.5 : scaled + 0.5;
+      if (rounded >= static_cast<double>(std::numeric_limits<Raw>::max())) {
+        return std::numeric_limits<Raw>::max();
+      }
+      if (rounded <= static_cast<double>(std::numeric_limits<Raw>::min())) {
+        return std::numeric_limits<Raw>::min();
+      }
+      return static_cast<Raw>(rounded);
+    } else {
+      return Saturate(static_cast<std::int64_t>(value) * kOne);
+    }
+  }
+
+  Raw raw_{0};
+};
+
+// Floor of the square root, bit by bit.
+[[nodiscard]]
+constexpr std::uint64_t IntegerSqrt(std::uint64_t value) {
+  if (value == 0) return 0;
+  std::uint64_t root = 0;
+  // highest power of four not above value
+  std::uint64_t bit = std::uint64_t{1} << ((std::bit_width(value) - 1) & ~1);
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+[[nodiscard]]
+constexpr Fixed Sqrt(const Fixed value) {
+  if (value.RawValue() <= 0) return {};
+  return Fixed::FromRaw(static_cast<Fixed::Raw>(
+      IntegerSqrt(static_cast<std::uint64_t>(value.RawValue())
+                  << Fixed::kFractionBits)));
+}
+
+// x * x + y * y in raw units squared, exact.
+[[nodiscard]]
+constexpr std::uint64_t RawLengthSquared(const Fixed x, const Fixed y) {
+  const std::int64_t rawX = x.RawValue();
+  const std::int64_t rawY = y.RawValue();
+  return static_cast<std::uint64_t>(rawX * rawX) +
+         static_cast<std::uint64_t>(rawY * rawY);
+}
+
+// sqrt(x * x + y * y) without squaring away the low bits.
+[[nodiscard]]
+constexpr Fixed Hypot(const Fixed x, const Fixed y) {
+  const std::uint64_t root = IntegerSqrt(RawLengthSquared(x, y));
+  return Fixed::FromRaw(static_cast<Fixed::Raw>(
+      std::min<std::uint64_t>(root, std::numeric_limits<Fixed::Raw>::max())));
+}
+
+[[nodiscard]]
+constexpr float ToFloat(const float value) {
+  return value;
+}
+
+[[nodiscard]]
+constexpr float ToFloat(const Fixed value) {
+  return value.ToFloat();
+}
+
+}  // namespace mp
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "game_data.hpp"
+
+namespace mp {
+
+// BasicWorldState with its players inline, up to MaxPlayers of them; those
+// past `playerCount` are unused. Trivially copyable, so saving or restoring
+// a tick for prediction, rollback or history is one memcpy of a few hundred
+// bytes instead of a vector copy. It goes over the wire exactly as a
+// BasicWorldState does, so either one reads the other's packets.
+template <typename T, std::size_t MaxPlayers = BasicWorldState<T>::maxPlayers>
+struct BasicFlatWorldState {
+  static constexpr std::size_t kMaxPlayers = MaxPlayers;
+
+  std::uint32_t playerCount{0};
+  std::array<BasicPlayer<T>, MaxPlayers> players{};
+  BasicPuck<T> puck{};
+  std::uint32_t goals[2]{};
+
+  [[nodiscard]]
+  std::span<BasicPlayer<T>> Players() {
+    return {players.data(), playerCount};
+  }
+
+  [[nodiscard]]
+  std::span<const BasicPlayer<T>> Players() const {
+    return {players.data(), playerCount};
+  }
+
+  // Assignment that copies only the players in use. Plain assignment copies
+  // all MaxPlayers of them, which compilers inline as a string move that is
+  // slow to start on some cpus; this is one memcpy call of the used ones.
+  void CopyFrom(const BasicFlatWorldState& other) {
+    playerCount = other.playerCount;
+    std::copy_n(other.players.begin(), playerCount, players.begin());
+    puck = other.puck;
+    goals[0] = other.goals[0];
+    goals[1] = other.goals[1];
+  }
+
+  // Players past MaxPlayers are dropped.
+  void Assign(const BasicWorldState<T>& world) {
+    playerCount = static_cast<std::uint32_t>(
+        std::min(world.players.size(), MaxPlayers));
+    std::copy_n(world.players.begin(), playerCount, players.begin());
+    puck = world.puck;
+    goals[0] = world.goals[0];
+    goals[1] = world.goals[1];
+  }
+
+  // Reuses the players' storage of `world`, so a warm one never allocates.
+  void CopyTo(BasicWorldState<T>& world) const {
+    world.players.assign(players.begin(), players.begin() + playerCount);
+    world.puck = puck;
+    world.goals[0] = goals[0];
+    world.goals[1] = goals[1];
+  }
+
+  [[nodiscard]]
+  BasicWorldState<T> ToWorldState() const {
+    BasicWorldState<T> world;
+    CopyTo(world);
+    return world;
+  }
+
+  template <typename Archive>
+  void save(Archive& ar) const {
+    ar(cereal::make_size_tag(static_cast<cereal::size_type>(playerCount)));
+    for (const BasicPlayer<T>& player : Players()) ar(player);
+    ar(puck, goals);
+  }
+
+  template <typename Archive>
+  void load(Archive& ar) {
+    cereal::size_type count = 0;
+    ar(cereal::make_size_tag(count));
+    if (count > MaxPlayers) {
+      throw std::runtime_error("World has more players than fit");
+    }
+    playerCount = static_cast<std::uint32_t>(count);
+    for (BasicPlayer<T>& player : Players()) ar(player);
+    ar(puck, goals);
+  }
+};
+
+using FlatWorldState = BasicFlatWorldState<Real>;
+
+static_assert(std::is_trivially_copyable_v<BasicFlatWorldState<float>>);
+static_assert(std::is_trivially_copyable_v<BasicFlatWorldState<Fixed>>);
+
+}  // namespace mp
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MP_HAS_MXCSR 1
+#endif
+
+namespace mp {
+
+// Switches flush-to-zero and denormals-are-zero on or off for the calling
+// thread and returns whether they were on. With both on, subnormal results
+// become zero and subnormal operands read as zero, so a float that decays
+// toward zero never lands on the slow path that x86 takes for subnormals
+// (100+ cycles an operation). Sim threads turn it on before their first
+// tick; it is a no-op on cpus without either mode.
+inline bool SetDenormalFlush(const bool bIsEnabled) {
+#if defined(MP_HAS_MXCSR)
+  // FTZ is bit 15 of MXCSR, DAZ bit 6
+  constexpr unsigned int kFlushBits = 0x8040;
+  const unsigned int csr = _mm_getcsr();
+  _mm_setcsr(bIsEnabled ? csr | kFlushBits : csr & ~kFlushBits);
+  return (csr & kFlushBits) == kFlushBits;
+#elif defined(__aarch64__)
+  // FZ, bit 24 of FPCR, flushes subnormal operands and results alike
+  constexpr std::uint64_t kFlushBit = std::uint64_t{1} << 24;
+  std::uint64_t fpcr = 0;
+  asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+  const std::uint64_t next = bIsEnabled ? fpcr | kFlushBit : fpcr & ~kFlushBit;
+  asm volatile("msr fpcr, %0" : : "r"(next));
+  return (fpcr & kFlushBit) != 0;
+#else
+  static_cast<void>(bIsEnabled);
+  return false;
+#endif
+}
+
+// Whether the calling thread has the modes of SetDenormalFlush on.
+[[nodiscard]]
+inline bool IsDenormalFlushEnabled() {
+#if defined(MP_HAS_MXCSR)
+  constexpr unsigned int kFlushBits = 0x8040;
+  return (_mm_getcsr() & kFlushBits) == kFlushBits;
+#elif defined(__aarch64__)
+  constexpr std::uint64_t kFlushBit = std::uint64_t{1} << 24;
+  std::uint64_t fpcr = 0;
+  asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+  return (fpcr & kFlushBit) != 0;
+#else
+  return false;
+#endif
+}
+
+}  // namespace mp
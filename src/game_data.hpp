@@ -3,136 +3,215 @@
 #include <algorithm>
 #include <cmath>
 #include <concepts>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 
+#include "fixed_point.hpp"
 #include "net_common.hpp"
 
 namespace mp {
 
-struct Vector2 {
-  float x, y;
+// Scalar of the physics. The float build is the default; define
+// MP_FIXED_POINT_PHYSICS for Q16.16, which steps bit-identically on every
+// compiler and cpu for replays and lockstep.
+#ifdef MP_FIXED_POINT_PHYSICS
+using Real = Fixed;
+#else
+using Real = float;
+#endif
 
-  template <typename T>
-    requires(std::is_arithmetic_v<T>)
-  constexpr Vector2& operator*=(const T val) {
+template <typename T>
+struct BasicVector2 {
+  T x, y;
+
+  template <typename U>
+    requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+  constexpr BasicVector2& operator*=(const U val) {
     x *= val;
     y *= val;
     return *this;
   }
-  template <typename T>
-    requires(std::is_arithmetic_v<T>)
-  constexpr Vector2& operator/=(const T val) {
+  template <typename U>
+    requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+  constexpr BasicVector2& operator/=(const U val) {
     x /= val;
     y /= val;
     return *this;
   }
-  constexpr Vector2& operator+=(const Vector2& rhs) {
+  constexpr BasicVector2& operator+=(const BasicVector2& rhs) {
     x += rhs.x;
     y += rhs.y;
     return *this;
   }
 
-  constexpr Vector2& operator-=(const Vector2& rhs) {
+  constexpr BasicVector2& operator-=(const BasicVector2& rhs) {
     x -= rhs.x;
     y -= rhs.y;
     return *this;
   }
 
   [[nodiscard]]
-  Vector2 operator-() const {
+  BasicVector2 operator-() const {
     return {.x = -x, .y = -y};
   }
 
   [[nodiscard]]
-  float Length() const {
-    return std::sqrtf(x * x + y * y);
+  T Length() const {
+    if constexpr (std::is_floating_point_v<T>) {
+      return std::sqrt(x * x + y * y);
+    } else {
+      return Hypot(x, y);
+    }
   }
 
   [[nodiscard]]
-  constexpr float LengthDoubled() const {
+  constexpr T LengthDoubled() const {
     return x * x + y * y;
   }
 
   [[nodiscard]]
-  constexpr float DotProduct(const Vector2& rhs) const {
+  constexpr T DotProduct(const BasicVector2& rhs) const {
     return x * rhs.x + y * rhs.y;
   }
 
   [[nodiscard]]
-  Vector2 Normalize() const {
-    const float length = Length();
+  BasicVector2 Normalize() const {
+    const T length = Length();
     return {.x = x / length, .y = y / length};
   }
 
   SERIALIZABLE(x, y)
 };
 
-template <typename T>
-  requires(std::is_arithmetic_v<T>)
-constexpr Vector2 operator*(Vector2 lhs, const T rhs) {
+template <typename T, typename U>
+  requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+constexpr BasicVector2<T> operator*(BasicVector2<T> lhs, const U rhs) {
   lhs *= rhs;
   return lhs;
 }
 
-template <typename T>
-  requires(std::is_arithmetic_v<T>)
-constexpr Vector2 operator/(Vector2 lhs, const T rhs) {
+template <typename T, typename U>
+  requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+constexpr BasicVector2<T> operator/(BasicVector2<T> lhs, const U rhs) {
   lhs /= rhs;
   return lhs;
 }
-template <typename T>
-  requires(std::is_arithmetic_v<T>)
-constexpr Vector2 operator*(const T rhs, Vector2 lhs) {
+template <typename T, typename U>
+  requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+constexpr BasicVector2<T> operator*(const U rhs, BasicVector2<T> lhs) {
   lhs *= rhs;
   return lhs;
 }
 
-template <typename T>
-  requires(std::is_arithmetic_v<T>)
-constexpr Vector2 operator/(const T rhs, Vector2 lhs) {
+template <typename T, typename U>
+  requires(std::is_arithmetic_v<U> || std::is_same_v<U, T>)
+constexpr BasicVector2<T> operator/(const U rhs, BasicVector2<T> lhs) {
   lhs /= rhs;
   return lhs;
 }
-[[nodiscard]] constexpr Vector2 operator+(Vector2 rhs, Vector2 lhs) {
+template <typename T>
+[[nodiscard]] constexpr BasicVector2<T> operator+(BasicVector2<T> rhs,
+                                                  BasicVector2<T> lhs) {
   rhs += lhs;
   return rhs;
 }
 
-[[nodiscard]] constexpr Vector2 operator-(Vector2 rhs, Vector2 lhs) {
+template <typename T>
+[[nodiscard]] constexpr BasicVector2<T> operator-(BasicVector2<T> rhs,
+                                                  BasicVector2<T> lhs) {
   rhs -= lhs;
   return rhs;
 }
 
-struct MoveableObject {
-  Vector2 pos{0.0f, 0.0f};
-  Vector2 velocity{0.0f, 0.0f};
-  float radius{.05f};
-  float mass{.05f};
+template <typename T>
+struct BasicMoveableObject {
+  BasicVector2<T> pos{0.0f, 0.0f};
+  BasicVector2<T> velocity{0.0f, 0.0f};
+  T radius{.05f};
+  T mass{.05f};
+  // Ticks the body has been slow for; asleep from kSleepTicks on, see
+  // simulation.hpp. Keeps counting while asleep. Server bookkeeping, so
+  // packets leave it out; see SerializeRestTicks for those that need it.
+  std::uint32_t restTicks{0};
   SERIALIZABLE(pos, velocity, radius, mass)
 };
 
-struct Player {
+template <typename T>
+struct BasicPlayer {
   static constexpr float baseRadius = 0.05f;
   std::uint32_t id{~0u};
   std::uint32_t teamId{~0u};
-  MoveableObject transform{.radius = baseRadius, .mass = .025f};
+  BasicMoveableObject<T> transform{.radius = baseRadius, .mass = .025f};
+  // Counts the client's inputs; snapshots echo the newest one applied.
+  std::uint32_t lastInputSequence{0};
 
-  SERIALIZABLE(id, teamId, transform)
+  SERIALIZABLE(id, teamId, transform, lastInputSequence)
 };
 
-struct Puck {
+template <typename T>
+struct BasicPuck {
   static constexpr float baseRadius = 0.02f;
-  MoveableObject transform{.radius = baseRadius, .mass = .01f};
+  BasicMoveableObject<T> transform{.radius = baseRadius, .mass = .01f};
   SERIALIZABLE(transform)
 };
 
-struct WorldState {
-  std::vector<Player> players;
-  Puck puck{};
+template <typename T>
+struct BasicWorldState {
+  std::vector<BasicPlayer<T>> players;
+  BasicPuck<T> puck{};
   std::uint32_t goals[2]{};
-  static constexpr mp::Vector2 leftRightLines{-.98f, .95f};
-  static constexpr mp::Vector2 teamsGoalsY{-0.78f, 0.78f};
-  static constexpr mp::Vector2 fieldBorders[2]{leftRightLines, {-.98f, .88f}};
+  static constexpr std::size_t maxPlayers = 10;
+  static constexpr BasicVector2<T> leftRightLines{-.98f, .95f};
+  static constexpr BasicVector2<T> teamsGoalsY{-0.78f, 0.78f};
+  static constexpr BasicVector2<T> fieldBorders[2]{leftRightLines,
+                                                   {-.98f, .88f}};
 
   SERIALIZABLE(players, puck, goals)
 };
+
+// Writes or reads the restTicks of every body of `world`, which serializing
+// the world itself leaves out, for payloads that must reproduce it exactly:
+// hashed snapshots and hash traces. Call after the world.
+template <typename Archive, typename World>
+void SerializeRestTicks(Archive& ar, World& world) {
+  ar(world.puck.transform.restTicks);
+  for (auto& player : world.players) ar(player.transform.restTicks);
+}
+
+// A whole world and the server tick it was taken after, the payload of
+// PacketType::WorldState.
+template <typename T>
+struct BasicTickedWorldState {
+  std::uint64_t tick{0};
+  BasicWorldState<T> world;
+
+  SERIALIZABLE(tick, world)
+};
+
+// An input and the tick of the world its client was showing when it was
+// made, which every snapshot tells clients.
+template <typename T>
+struct BasicTaggedInput {
+  BasicPlayer<T> player;
+  std::uint64_t renderTick{0};
+
+  SERIALIZABLE(player, renderTick)
+};
+
+using Vector2 = BasicVector2<Real>;
+using MoveableObject = BasicMoveableObject<Real>;
+using Player = BasicPlayer<Real>;
+using Puck = BasicPuck<Real>;
+using WorldState = BasicWorldState<Real>;
+using TickedWorldState = BasicTickedWorldState<Real>;
+using TaggedInput = BasicTaggedInput<Real>;
+
+// What rendering and other float consumers take, whatever Real is.
+using Vector2f = BasicVector2<float>;
+
+template <typename T>
+[[nodiscard]] constexpr Vector2f ToFloat(const BasicVector2<T> value) {
+  return {ToFloat(value.x), ToFloat(value.y)};
+}
 }  // namespace mp
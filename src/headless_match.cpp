@@ -0,0 +1,369 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bot_client.hpp"
+#include "float_env.hpp"
+#include "impaired_transport.hpp"
+#include "loopback_server.hpp"
+#include "loopback_transport.hpp"
+#include "sim_clock.hpp"
+#include "world_hash.hpp"
+
+// A whole match between the in-process server and headless bots on one
+// thread and a virtual clock: an hour of play takes seconds. Every actor
+// sees the tick's scheduled time, never the wall clock, so --realtime, which
+// only paces the same loop at wall-clock speed, ends in the same world.
+//
+// --record-hashes writes every room's world hash after every tick;
+// --check-hashes runs the same match again and stops at the first tick that
+// hashes differently, naming the field when the trace has the worlds too.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint16_t kMatchPort = 5000;
+
+struct MatchOptions {
+  std::chrono::seconds duration{std::chrono::minutes(60)};
+  std::size_t botCount{10};
+  std::chrono::microseconds tickPeriod{10'000};
+  std::chrono::microseconds inputPeriod{50'000};
+  mp::BotInputMode inputMode{mp::BotInputMode::Random};
+  std::uint64_t seed{1};
+  bool bIsRealTime{false};
+  std::optional<mp::ImpairmentConfig> impairment;
+  bool bHashSnapshots{false};
+  std::string recordPath;
+  std::string checkPath;
+  bool bTracesWorlds{false};
+  // the arguments that decide how the match plays out, kept in traces
+  std::string matchArgs;
+};
+
+MatchOptions ParseOptions(const int argc, char* argv[]) {
+  MatchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const int first = i;
+    bool bShapesMatch = true;
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    const auto impairment = [&]() -> mp::ImpairmentConfig& {
+      return options.impairment ? *options.impairment
+                                : options.impairment.emplace();
+    };
+    if (arg == "--minutes") {
+      options.duration = std::chrono::minutes(std::max(0, std::atoi(value())));
+    } else if (arg == "--seconds") {
+      options.duration = std::chrono::seconds(std::max(0, std::atoi(value())));
+    } else if (arg == "--bots") {
+      options.botCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--tick-hz") {
+      options.tickPeriod = std::chrono::microseconds(
+          1'000'000 / std::max(1, std::atoi(value())));
+    } else if (arg == "--input-hz") {
+      options.inputPeriod = std::chrono::microseconds(
+          1'000'000 / std::max(1, std::atoi(value())));
+    } else if (arg == "--script") {
+      options.inputMode = mp::BotInputMode::Script;
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--realtime") {
+      options.bIsRealTime = true;
+      bShapesMatch = false;
+    } else if (arg == "--impair-out") {
+      impairment().outbound = mp::ParseImpairmentProfile(value());
+    } else if (arg == "--impair-in") {
+      impairment().inbound = mp::ParseImpairmentProfile(value());
+    } else if (arg == "--hash-snapshots") {
+      options.bHashSnapshots = true;
+      bShapesMatch = false;
+    } else if (arg == "--record-hashes") {
+      options.recordPath = value();
+      bShapesMatch = false;
+    } else if (arg == "--check-hashes") {
+      options.checkPath = value();
+      bShapesMatch = false;
+    } else if (arg == "--trace-worlds") {
+      options.bTracesWorlds = true;
+      bShapesMatch = false;
+    } else {
+      throw std::runtime_error(
+          "Usage: headless_match [--minutes n | --seconds n] [--bots n] "
+          "[--tick-hz n] [--input-hz n] [--script] [--seed n] [--realtime] "
+          "[--impair-out spec] [--impair-in spec] [--hash-snapshots] "
+          "[--record-hashes file [--trace-worlds] | --check-hashes file]");
+    }
+    for (int j = first; bShapesMatch && j <= i; ++j) {
+      options.matchArgs += " " + std::string(argv[j]);
+    }
+  }
+  if (!options.recordPath.empty() && !options.checkPath.empty()) {
+    throw std::runtime_error("Pick one of --record-hashes and --check-hashes");
+  }
+  if (options.impairment) options.impairment->seed = options.seed;
+  return options;
+}
+
+struct Seat {
+  std::unique_ptr<mp::LoopbackTransport> transport;
+  std::unique_ptr<mp::ImpairedTransport> impaired;
+  std::unique_ptr<mp::BotClient> bot;
+
+  mp::Transport& Net() {
+    if (impaired) return *impaired;
+    return *transport;
+  }
+};
+
+#ifdef MP_FIXED_POINT_PHYSICS
+constexpr std::string_view kPhysics = "fixed";
+#else
+constexpr std::string_view kPhysics = "float";
+#endif
+
+constexpr std::uint32_t kTraceVersion = 2;
+
+// A hash trace: this header, then one TraceTick per tick of the match.
+struct TraceHeader {
+  std::uint32_t version{kTraceVersion};
+  std::string match;  // physics and the arguments that shape the match
+  bool bHasWorlds{false};
+
+  SERIALIZABLE(version, match, bHasWorlds)
+};
+
+struct TraceTick {
+  std::vector<std::uint64_t> hashes;  // one per room
+  std::vector<mp::WorldState> worlds;  // with --trace-worlds
+
+  template <typename Archive>
+  void serialize(Archive& ar) {
+    ar(hashes, worlds);
+    for (mp::WorldState& world : worlds) mp::SerializeRestTicks(ar, world);
+  }
+};
+
+class HashTrace {
+ public:
+  HashTrace(const MatchOptions& options, std::string match)
+      : match_(std::move(match)) {
+    if (!options.recordPath.empty()) {
+      output_.emplace(options.recordPath, std::ios::binary);
+      if (!*output_) {
+        throw std::runtime_error("Failed to create " + options.recordPath);
+      }
+      writer_.emplace(*output_);
+      header_ = {.match = match_, .bHasWorlds = options.bTracesWorlds};
+      (*writer_)(header_);
+    } else if (!options.checkPath.empty()) {
+      input_.emplace(options.checkPath, std::ios::binary);
+      if (!*input_) {
+        throw std::runtime_error("Failed to open " + options.checkPath);
+      }
+      reader_.emplace(*input_);
+      (*reader_)(header_);
+      if (header_.version != kTraceVersion) {
+        throw std::runtime_error(options.checkPath + " is not a hash trace");
+      }
+      if (header_.match != match_) {
+        throw std::runtime_error("The trace was recorded for a different "
+                                 "match: " + header_.match);
+      }
+    }
+  }
+
+  // Writes or checks the rooms after `tick`; false on the first desync.
+  bool OnTick(const std::uint64_t tick, const mp::LoopbackServer& server) {
+    if (writer_) {
+      TraceTick entry;
+      for (std::size_t room = 0; room < server.RoomCount(); ++room) {
+        const mp::WorldState& world = server.RoomServer(room).World();
+        entry.hashes.push_back(mp::HashWorld(world));
+        if (header_.bHasWorlds) entry.worlds.push_back(world);
+      }
+      (*writer_)(entry);
+      return true;
+    }
+    if (!reader_) return true;
+
+    TraceTick entry;
+    (*reader_)(entry);
+    if (entry.hashes.size() != server.RoomCount()) {
+      std::cout << "desync at tick " << tick << ": " << server.RoomCount()
+                << " rooms, the trace has " << entry.hashes.size() << "\n";
+      return false;
+    }
+    while (detectors_.size() < server.RoomCount()) {
+      detectors_.push_back(
+          std::make_unique<mp::DesyncDetector>(1, header_.bHasWorlds));
+    }
+    for (std::size_t room = 0; room < server.RoomCount(); ++room) {
+      mp::DesyncDetector& detector = *detectors_[room];
+      detector.Record(tick, server.RoomServer(room).World());
+      if (detector.Check(tick, entry.hashes[room],
+                         header_.bHasWorlds ? &entry.worlds[room] : nullptr)) {
+        continue;
+      }
+      const mp::Desync& desync = *detector.FirstDesync();
+      std::cout << "desync in room " << room << " at tick " << desync.tick
+                << std::hex << ": hash " << desync.localHash
+                << ", the trace has " << desync.remoteHash << std::dec
+                << "\n";
+      if (desync.difference) {
+        std::cout << "  first difference " << desync.difference->field
+                  << ": trace " << desync.difference->expected << ", run "
+                  << desync.difference->actual << "\n";
+      }
+      return false;
+    }
+    checkedTicks_++;
+    return true;
+  }
+
+  [[nodiscard]]
+  bool IsChecking() const {
+    return reader_.has_value();
+  }
+
+  [[nodiscard]]
+  std::uint64_t CheckedTicks() const {
+    return checkedTicks_;
+  }
+
+ private:
+  std::string match_;
+  TraceHeader header_;
+  std::optional<std::ofstream> output_;
+  std::optional<cereal::PortableBinaryOutputArchive> writer_;
+  std::optional<std::ifstream> input_;
+  std::optional<cereal::PortableBinaryInputArchive> reader_;
+  std::vector<std::unique_ptr<mp::DesyncDetector>> detectors_;
+  std::uint64_t checkedTicks_{0};
+};
+
+// FNV-1a over every room's snapshot, to compare the end of two runs.
+std::uint64_t WorldChecksum(const mp::LoopbackServer& server) {
+  std::uint64_t hash = 0xCBF29CE484222325ull;
+  for (std::size_t room = 0; room < server.RoomCount(); ++room) {
+    mp::WorldState world = server.RoomServer(room).World();
+    const std::string snapshot =
+        mp::SerializePacket(mp::PacketType::WorldState, world);
+    for (const char byte : snapshot) {
+      hash = (hash ^ static_cast<std::uint8_t>(byte)) * 0x100000001B3ull;
+    }
+  }
+  return hash;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const MatchOptions options = ParseOptions(argc, argv);
+  // the match runs on this thread, like a worker's rooms
+  mp::SetDenormalFlush(true);
+
+  mp::VirtualClock clock;
+  mp::LoopbackNetwork network;
+  mp::LoopbackServer server(network, kMatchPort, options.tickPeriod, clock,
+                            options.seed);
+  server.SetSnapshotHashes(options.bHashSnapshots);
+  HashTrace trace(options, std::string(kPhysics) + options.matchArgs);
+
+  std::vector<Seat> seats(options.botCount);
+  for (std::size_t i = 0; i < seats.size(); ++i) {
+    Seat& seat = seats[i];
+    seat.transport = std::make_unique<mp::LoopbackTransport>(network);
+    if (options.impairment) {
+      mp::ImpairmentConfig config = *options.impairment;
+      config.seed += i;
+      seat.impaired = std::make_unique<mp::ImpairedTransport>(*seat.transport,
+                                                              config, clock);
+    }
+    seat.bot = std::make_unique<mp::BotClient>(
+        static_cast<std::uint32_t>(i), options.inputMode, options.inputPeriod,
+        options.seed);
+    seat.bot->Connect(seat.Net(), "loopback", kMatchPort);
+  }
+
+  const std::uint64_t ticks = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(options.duration) /
+      options.tickPeriod);
+  const mp::SimClock::time_point start = clock.Now();
+  const Clock::time_point wallStart = Clock::now();
+  mp::TransportEvent event;
+  bool bIsInSync = true;
+  for (std::uint64_t tick = 0; tick < ticks && bIsInSync; ++tick) {
+    const mp::SimClock::time_point now =
+        start + static_cast<std::int64_t>(tick) * options.tickPeriod;
+    clock.SleepUntil(now);
+    if (options.bIsRealTime) {
+      std::this_thread::sleep_until(wallStart + (now - start));
+    }
+
+    server.Step();
+    bIsInSync = trace.OnTick(tick + 1, server);
+    for (Seat& seat : seats) {
+      while (seat.Net().Poll(event)) seat.bot->OnEvent(event, now);
+      seat.bot->Update(seat.Net(), now);
+    }
+  }
+  if (!bIsInSync) return 1;
+  clock.SleepUntil(start + static_cast<std::int64_t>(ticks) *
+                               options.tickPeriod);
+  const double wallSeconds =
+      std::chrono::duration<double>(Clock::now() - wallStart).count();
+  const double matchSeconds =
+      std::chrono::duration<double>(clock.Now() - start).count();
+
+  std::uint64_t snapshots = 0;
+  std::uint64_t inputs = 0;
+  std::uint64_t hashMismatches = 0;
+  for (const Seat& seat : seats) {
+    snapshots += seat.bot->Traffic().snapshots;
+    inputs += seat.bot->Traffic().inputsSent;
+    hashMismatches += seat.bot->Traffic().hashMismatches;
+  }
+  std::cout << std::fixed << std::setprecision(2) << "match " << matchSeconds
+            << " s in " << wallSeconds << " s wall ("
+            << (wallSeconds > 0 ? matchSeconds / wallSeconds : 0.0)
+            << "x), " << server.Ticks() << " ticks, " << inputs
+            << " inputs sent, " << snapshots << " snapshots received, "
+            << server.BytesSent() << " snapshot bytes\n";
+  for (std::size_t room = 0; room < server.RoomCount(); ++room) {
+    const mp::GameServer& roomServer = server.RoomServer(room);
+    const mp::WorldState& world = roomServer.World();
+    std::cout << "room " << room << ": " << world.players.size()
+              << " players, goals " << world.goals[0] << ":" << world.goals[1]
+              << ", " << roomServer.CompensatedHits()
+              << " lag-compensated hits\n";
+  }
+  if (options.bHashSnapshots) {
+    std::cout << hashMismatches << " snapshots did not match their hash\n";
+  }
+  if (trace.IsChecking()) {
+    std::cout << trace.CheckedTicks() << " ticks match the trace\n";
+  }
+  std::cout << "world checksum " << std::hex << std::setw(16)
+            << std::setfill('0') << WorldChecksum(server) << "\n";
+  return options.bHashSnapshots && hashMismatches > 0 ? 1 : 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "sim_clock.hpp"
+#include "transport.hpp"
+
+namespace mp {
+
+// Bad network conditions for one direction of one peer. Zero disables a
+// feature. Delays are per packet: latency + uniform [0, jitter].
+struct ImpairmentProfile {
+  std::chrono::microseconds latency{0};
+  std::chrono::microseconds jitter{0};
+  // loss probability in the good state, or the only one without bursts
+  double lossRate{0.0};
+  // Gilbert-Elliott bursts: chance per packet to enter / leave the bad state
+  // and the loss probability while in it
+  double burstEnterRate{0.0};
+  double burstExitRate{1.0};
+  double burstLossRate{1.0};
+  double duplicateRate{0.0};
+  // reordered packets are held back by `reorderDelay` and get overtaken
+  double reorderRate{0.0};
+  std::chrono::microseconds reorderDelay{20'000};
+  std::uint64_t bitsPerSecond{0};
+  // tail drop once the bandwidth-limited link is that far behind
+  std::chrono::microseconds maxQueueDelay{250'000};
+  // a reliable packet "lost" here costs this much per attempt, doubling, as
+  // the reliability layer below would retransmit it
+  std::chrono::microseconds retransmitTimeout{200'000};
+
+  [[nodiscard]]
+  bool IsEnabled() const {
+    return latency.count() || jitter.count() || lossRate > 0 ||
+           burstEnterRate > 0 || duplicateRate > 0 || reorderRate > 0 ||
+           bitsPerSecond;
+  }
+};
+
+struct ImpairmentConfig {
+  ImpairmentProfile outbound;
+  ImpairmentProfile inbound;
+  std::uint64_t seed{1};
+};
+
+struct ImpairmentStats {
+  std::uint64_t packets{0};
+  std::uint64_t dropped{0};
+  std::uint64_t retransmitted{0};
+  std::uint64_t duplicated{0};
+  std::uint64_t reordered{0};
+  std::uint64_t stale{0};
+};
+
+// "latency=50,jitter=10,loss=0.01,burst=0.01:0.3,dup=0.001,reorder=0.01,
+// rate=2000" with times in ms and rate in kbit/s. Throws on unknown keys.
+inline ImpairmentProfile ParseImpairmentProfile(const std::string_view spec) {
+  const auto milliseconds = [](const std::string& value) {
+    return std::chrono::microseconds(
+        static_cast<std::int64_t>(std::atof(value.c_str()) * 1000.0));
+  };
+
+  ImpairmentProfile profile;
+  std::size_t begin = 0;
+  while (begin < spec.size()) {
+    std::size_t end = spec.find(',', begin);
+    if (end == std::string_view::npos) end = spec.size();
+    const std::string_view item = spec.substr(begin, end - begin);
+    begin = end + 1;
+    if (item.empty()) continue;
+
+    const std::size_t equals = item.find('=');
+    if (equals == std::string_view::npos) {
+      throw std::runtime_error("Impairment needs key=value: " +
+                               std::string(item));
+    }
+    const std::string_view key = item.substr(0, equals);
+    const std::string value(item.substr(equals + 1));
+    if (key == "latency") {
+      profile.latency = milliseconds(value);
+    } else if (key == "jitter") {
+      profile.jitter = milliseconds(value);
+    } else if (key == "loss") {
+      profile.lossRate = std::atof(value.c_str());
+    } else if (key == "burst") {
+      // enter:exit[:loss]
+      const std::size_t colon = value.find(':');
+      profile.burstEnterRate = std::atof(value.c_str());
+      if (colon != std::string::npos) {
+        profile.burstExitRate = std::atof(value.c_str() + colon + 1);
+        const std::size_t second = value.find(':', colon + 1);
+        if (second != std::string::npos) {
+          profile.burstLossRate = std::atof(value.c_str() + second + 1);
+        }
+      }
+    } else if (key == "dup") {
+      profile.duplicateRate = std::atof(value.c_str());
+    } else if (key == "reorder") {
+      profile.reorderRate = std::atof(value.c_str());
+    } else if (key == "reorder-delay") {
+      profile.reorderDelay = milliseconds(value);
+    } else if (key == "rate") {
+      profile.bitsPerSecond =
+          static_cast<std::uint64_t>(std::atof(value.c_str()) * 1000.0);
+    } else if (key == "queue") {
+      profile.maxQueueDelay = milliseconds(value);
+    } else if (key == "rto") {
+      profile.retransmitTimeout = milliseconds(value);
+    } else {
+      throw std::runtime_error("Unknown impairment: " + std::string(key));
+    }
+  }
+  return profile;
+}
+
+// Decorator that delays, drops, duplicates and reorders packets on their way
+// through another transport. Both directions are impaired independently for
+// every peer, each from its own random stream derived from the seed, so a
+// run is reproducible for a given order of calls.
+//
+// It sits above the reliability layer: reliable packets are never lost but
+// pay a retransmit delay instead, and stay in order within their channel.
+// Unreliable sequenced packets that arrive after a newer one are dropped the
+// way ENet drops them. Delayed packets leave on Poll or Flush, so an event
+// loop calls either at NextRelease. Release times follow `clock`; on a
+// virtual clock a Poll with a timeout moves time forward instead of blocking.
+class ImpairedTransport final : public Transport {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ImpairedTransport(const ImpairedTransport& other) = delete;
+  ImpairedTransport& operator=(const ImpairedTransport& other) = delete;
+
+  ImpairedTransport(Transport& inner, const ImpairmentConfig& config,
+                    SimClock& clock = SystemClock::Instance())
+      : inner_(inner), config_(config), clock_(clock) {}
+
+  // Overrides the configured profiles for one peer.
+  void SetPeerProfile(const PeerId peer, const ImpairmentProfile& outbound,
+                      const ImpairmentProfile& inbound) {
+    PeerState& state = Peer(peer);
+    state.directions[kOutbound].profile = outbound;
+    state.directions[kInbound].profile = inbound;
+  }
+
+  [[nodiscard]]
+  const ImpairmentStats& Stats() const {
+    return stats_;
+  }
+
+  // When the next held back packet or event is due in either direction, if
+  // any is held back.
+  [[nodiscard]]
+  std::optional<Clock::time_point> NextRelease() const {
+    std::optional<Clock::time_point> next;
+    for (const auto* queue : {&inbound_, &outbound_}) {
+      if (queue->empty()) continue;
+      const Clock::time_point release = queue->front().release;
+      next = next ? std::min(*next, release) : release;
+    }
+    return next;
+  }
+
+  PeerId Connect(const std::string& host, const std::uint16_t port,
+                 const std::size_t channelCount) override {
+    return inner_.Connect(host, port, channelCount);
+  }
+
+  void Send(const PeerId peer, const std::span<const std::uint8_t> data,
+            const std::uint8_t channel, const std::uint32_t flags) override {
+    Admit(kOutbound, {.type = TransportEventType::Receive,
+                      .peer = peer,
+                      .channel = channel},
+          data, flags);
+    ReleaseOutbound(clock_.Now());
+  }
+
+  void Broadcast(const std::span<const std::uint8_t> data,
+                 const std::uint8_t channel,
+                 const std::uint32_t flags) override {
+    for (const PeerId peer : connected_) Send(peer, data, channel, flags);
+  }
+
+  bool Poll(TransportEvent& event,
+            const std::uint32_t timeoutMs = 0) override {
+    const Clock::time_point deadline =
+        clock_.Now() + std::chrono::milliseconds(timeoutMs);
+    TransportEvent innerEvent;
+    for (;;) {
+      Clock::time_point now = clock_.Now();
+      ReleaseOutbound(now);
+      while (inner_.Poll(innerEvent)) AdmitInbound(innerEvent);
+      if (PopInbound(clock_.Now(), event)) return true;
+
+      now = clock_.Now();
+      if (now >= deadline) return false;
+      Clock::time_point wake = deadline;
+      for (const auto* queue : {&inbound_, &outbound_}) {
+        if (!queue->empty()) wake = std::min(wake, queue->front().release);
+      }
+      if (!clock_.IsRealTime()) {
+        clock_.SleepUntil(wake);
+        continue;
+      }
+      const auto wait =
+          std::chrono::ceil<std::chrono::milliseconds>(wake - now);
+      if (inner_.Poll(innerEvent,
+                      static_cast<std::uint32_t>(std::max<std::int64_t>(
+                          wait.count(), 0)))) {
+        AdmitInbound(innerEvent);
+      }
+    }
+  }
+
+  void Flush() override {
+    ReleaseOutbound(clock_.Now());
+    inner_.Flush();
+  }
+
+  void Disconnect(const PeerId peer) override {
+    // after whatever is still queued for the peer
+    Admit(kOutbound, {.type = TransportEventType::Disconnect, .peer = peer},
+          {}, kPacketReliable);
+  }
+
+  void Reset(const PeerId peer) override {
+    Forget(peer);
+    inner_.Reset(peer);
+  }
+
+ private:
+  enum DirectionIndex : std::size_t { kOutbound = 0, kInbound = 1 };
+
+  struct Direction {
+    ImpairmentProfile profile;
+    std::mt19937_64 rng;
+    bool bIsBursting{false};
+    Clock::time_point linkFreeAt{};
+    Clock::time_point fifoRelease{};
+    Clock::time_point lastRelease{};
+    std::unordered_map<std::uint16_t, Clock::time_point> reliableRelease;
+    std::unordered_map<std::uint8_t, std::uint64_t> sequenced;
+    std::unordered_map<std::uint8_t, std::uint64_t> delivered;
+  };
+
+  struct PeerState {
+    std::uint64_t generation{0};
+    Direction directions[2];
+  };
+
+  struct Pending {
+    Clock::time_point release;
+    std::uint64_t order;
+    std::uint64_t generation;
+    // outbound: Receive is a packet to send, Disconnect a deferred disconnect
+    TransportEvent event;
+    std::uint32_t flags;
+    std::uint64_t sequence;
+    std::vector<std::uint8_t> bytes;
+  };
+
+  static bool Later(const Pending& a, const Pending& b) {
+    return a.release != b.release ? a.release > b.release : a.order > b.order;
+  }
+
+  PeerState& Peer(const PeerId peer) {
+    const auto [it, bIsNew] = peers_.try_emplace(peer);
+    if (bIsNew) {
+      std::seed_seq seed{static_cast<std::uint32_t>(config_.seed),
+                         static_cast<std::uint32_t>(config_.seed >> 32), peer,
+                         static_cast<std::uint32_t>(generations_[peer])};
+      std::uint64_t seeds[2];
+      seed.generate(reinterpret_cast<std::uint32_t*>(seeds),
+                    reinterpret_cast<std::uint32_t*>(seeds + 2));
+      it->second.generation = generations_[peer];
+      it->second.directions[kOutbound].profile = config_.outbound;
+      it->second.directions[kOutbound].rng.seed(seeds[0]);
+      it->second.directions[kInbound].profile = config_.inbound;
+      it->second.directions[kInbound].rng.seed(seeds[1]);
+    }
+    return it->second;
+  }
+
+  // Queued packets of a gone peer must not reach whoever gets its id next.
+  void Forget(const PeerId peer) {
+    peers_.erase(peer);
+    connected_.erase(peer);
+    generations_[peer]++;
+  }
+
+  void AdmitInbound(const TransportEvent& event) {
+    switch (event.type) {
+      case TransportEventType::Connect:
+        connected_.insert(event.peer);
+        Admit(kInbound, event, {}, kPacketReliable);
+        break;
+      case TransportEventType::Disconnect:
+        // the peer is forgotten once its queued packets were delivered
+        Admit(kInbound, event, {}, kPacketReliable);
+        break;
+      case TransportEventType::Receive:
+        Admit(kInbound, event, event.data, event.flags);
+        break;
+    }
+  }
+
+  void Admit(const DirectionIndex index, const TransportEvent& event,
+             const std::span<const std::uint8_t> data,
+             const std::uint32_t flags) {
+    const Clock::time_point now = clock_.Now();
+    PeerState& peer = Peer(event.peer);
+    Direction& direction = peer.directions[index];
+    const ImpairmentProfile& profile = direction.profile;
+    std::vector<Pending>& queue = index == kOutbound ? outbound_ : inbound_;
+
+    Pending pending{.release = now,
+                    .order = nextOrder_++,
+                    .generation = peer.generation,
+                    .event = event,
+                    .flags = flags,
+                    .sequence = 0};
+    pending.event.data = {};
+
+    if (event.type != TransportEventType::Receive || !profile.IsEnabled()) {
+      // control events go after every packet queued before them
+      if (event.type != TransportEventType::Receive) {
+        pending.release = std::max(now, direction.lastRelease);
+      }
+      pending.bytes.assign(data.begin(), data.end());
+      Push(queue, std::move(pending));
+      return;
+    }
+
+    stats_.packets++;
+    const bool bIsReliable = flags & kPacketReliable;
+    const bool bIsSequenced = !(flags & kPacketUnsequenced);
+    if (!bIsReliable && bIsSequenced) {
+      pending.sequence = ++direction.sequenced[event.channel];
+    }
+
+    // the reliability layer drops duplicates itself
+    const int copies =
+        !bIsReliable && Chance(direction, profile.duplicateRate) ? 2 : 1;
+    if (copies == 2) stats_.duplicated++;
+    for (int copy = 0; copy < copies; ++copy) {
+      // serialization on the capped link, then propagation
+      Clock::time_point departure = now;
+      if (profile.bitsPerSecond) {
+        departure = std::max(now, direction.linkFreeAt);
+        if (departure - now > profile.maxQueueDelay) {
+          stats_.dropped++;
+          continue;
+        }
+        direction.linkFreeAt =
+            departure + std::chrono::nanoseconds(data.size() * 8'000'000'000 /
+                                                 profile.bitsPerSecond);
+        departure = direction.linkFreeAt;
+      }
+      // jitter alone keeps the link FIFO; only reordering overtakes
+      Clock::time_point release = departure + profile.latency;
+      if (profile.jitter.count() > 0) {
+        release += std::chrono::microseconds(
+            std::uniform_int_distribution<std::int64_t>(
+                0, profile.jitter.count())(direction.rng));
+      }
+      release = std::max(release, direction.fifoRelease);
+      direction.fifoRelease = release;
+
+      // retransmits leave long after a burst, so they only see random loss
+      std::chrono::microseconds retransmit = profile.retransmitTimeout;
+      bool bIsLost = IsLost(direction);
+      for (int attempt = 0; bIsLost && bIsReliable && attempt < 8; ++attempt) {
+        stats_.retransmitted++;
+        release += retransmit;
+        retransmit *= 2;
+        bIsLost = Chance(direction, profile.lossRate);
+      }
+      if (bIsLost) {
+        stats_.dropped++;
+        continue;
+      }
+      if (Chance(direction, profile.reorderRate)) {
+        stats_.reordered++;
+        release += profile.reorderDelay;
+      }
+      if (bIsReliable) {
+        Clock::time_point& last = direction.reliableRelease[event.channel];
+        release = std::max(release, last);
+        last = release;
+      }
+      direction.lastRelease = std::max(direction.lastRelease, release);
+
+      Pending copyPending = pending;
+      copyPending.order = copy == 0 ? pending.order : nextOrder_++;
+      copyPending.release = release;
+      copyPending.bytes.assign(data.begin(), data.end());
+      Push(queue, std::move(copyPending));
+    }
+  }
+
+  static bool Chance(Direction& direction, const double probability) {
+    return probability > 0 &&
+           std::uniform_real_distribution<double>(0.0, 1.0)(direction.rng) <
+               probability;
+  }
+
+  // Gilbert-Elliott: a two state chain advanced once per transmission.
+  static bool IsLost(Direction& direction) {
+    const ImpairmentProfile& profile = direction.profile;
+    if (direction.bIsBursting) {
+      if (Chance(direction, profile.burstExitRate)) {
+        direction.bIsBursting = false;
+      }
+    } else if (Chance(direction, profile.burstEnterRate)) {
+      direction.bIsBursting = true;
+    }
+    return Chance(direction, direction.bIsBursting ? profile.burstLossRate
+                                                   : profile.lossRate);
+  }
+
+  static void Push(std::vector<Pending>& queue, Pending pending) {
+    queue.push_back(std::move(pending));
+    std::push_heap(queue.begin(), queue.end(), Later);
+  }
+
+  static Pending Pop(std::vector<Pending>& queue) {
+    std::pop_heap(queue.begin(), queue.end(), Later);
+    Pending pending = std::move(queue.back());
+    queue.pop_back();
+    return pending;
+  }
+
+  // Unreliable sequenced packets overtaken by a newer one are stale.
+  bool IsCurrent(const PeerId peer, const DirectionIndex index,
+                 const Pending& pending) {
+    const auto it = peers_.find(peer);
+    if (it == peers_.end() || it->second.generation != pending.generation) {
+      return false;
+    }
+    if (pending.sequence == 0) return true;
+    std::uint64_t& delivered =
+        it->second.directions[index].delivered[pending.event.channel];
+    if (pending.sequence <= delivered) {
+      stats_.stale++;
+      return false;
+    }
+    delivered = pending.sequence;
+    return true;
+  }
+
+  void ReleaseOutbound(const Clock::time_point now) {
+    while (!outbound_.empty() && outbound_.front().release <= now) {
+      Pending pending = Pop(outbound_);
+      const PeerId peer = pending.event.peer;
+      if (!IsCurrent(peer, kOutbound, pending)) continue;
+      if (pending.event.type == TransportEventType::Disconnect) {
+        inner_.Disconnect(peer);
+      } else {
+        inner_.Send(peer, pending.bytes, pending.event.channel, pending.flags);
+      }
+    }
+  }
+
+  bool PopInbound(const Clock::time_point now, TransportEvent& event) {
+    while (!inbound_.empty() && inbound_.front().release <= now) {
+      Pending pending = Pop(inbound_);
+      if (pending.event.type == TransportEventType::Disconnect) {
+        Forget(pending.event.peer);
+      } else if (pending.event.type == TransportEventType::Receive &&
+                 !IsCurrent(pending.event.peer, kInbound, pending)) {
+        continue;
+      }
+      delivered_ = std::move(pending.bytes);
+      event = pending.event;
+      event.data = delivered_;
+      return true;
+    }
+    return false;
+  }
+
+  Transport& inner_;
+  ImpairmentConfig config_;
+  SimClock& clock_;
+  ImpairmentStats stats_;
+  std::unordered_map<PeerId, PeerState> peers_;
+  std::unordered_map<PeerId, std::uint64_t> generations_;
+  std::unordered_set<PeerId> connected_;
+  std::vector<Pending> outbound_;
+  std::vector<Pending> inbound_;
+  std::vector<std::uint8_t> delivered_;
+  std::uint64_t nextOrder_{0};
+};
+
+}  // namespace mp
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "game_data.hpp"
+#include "simulation.hpp"
+
+namespace mp {
+
+// Furthest back an input can reach for the puck; older render ticks count
+// as this old.
+constexpr std::chrono::milliseconds kMaxLagCompensation{200};
+
+// Server side lag compensation of puck hits. A client draws the world of the
+// last snapshot it got, so its player aims at a puck that has moved on by
+// the time the input arrives. The puck's positions over the window are kept
+// in a ring of a few hundred bytes, indexed by tick, so checking an input
+// against the puck its player saw is one lookup and one contact test however
+// many players the room has.
+template <typename T>
+class BasicLagCompensator {
+ public:
+  using Vector = BasicVector2<T>;
+
+  BasicLagCompensator(const BasicLagCompensator& other) = delete;
+  BasicLagCompensator& operator=(const BasicLagCompensator& other) = delete;
+
+  BasicLagCompensator(const std::chrono::microseconds window,
+                      const std::chrono::microseconds tickPeriod)
+      : samples_(static_cast<std::size_t>(
+                     window / std::max(tickPeriod,
+                                       std::chrono::microseconds{1})) +
+                 1) {}
+
+  // Where the puck is at the end of `tick`; ticks come in increasing order.
+  void Record(const std::uint64_t tick, const Vector puckPos) {
+    samples_[tick % samples_.size()] = {tick, puckPos};
+    newest_ = tick;
+    bHasTicks_ = true;
+  }
+
+  // Where the puck was at the end of `tick`, which is clamped into the
+  // window; nothing for ticks not recorded yet or never recorded.
+  [[nodiscard]]
+  std::optional<Vector> PuckAt(std::uint64_t tick) const {
+    if (!bHasTicks_ || tick > newest_) return std::nullopt;
+    tick = std::max(tick, OldestInWindow());
+    const Sample& sample = samples_[tick % samples_.size()];
+    if (sample.tick != tick) return std::nullopt;
+    return sample.pos;
+  }
+
+  // Lets `player`, whose input was made looking at the world of
+  // `renderTick`, hit the puck where it was then: when the player touches
+  // that position and not the puck's current one, both get the response of
+  // a contact with the puck as seen, the puck staying where it is. Contacts
+  // with the current puck are left to the tick. Returns whether it hit.
+  bool CompensateHit(BasicMoveableObject<T>& player,
+                     BasicMoveableObject<T>& puck,
+                     const std::uint64_t renderTick) const {
+    if (renderTick >= newest_) return false;
+    const std::optional<Vector> seenPos = PuckAt(renderTick);
+    if (!seenPos) return false;
+    if (IsColliding(player.pos, player.radius, puck.pos, puck.radius) ||
+        !IsColliding(player.pos, player.radius, *seenPos, puck.radius)) {
+      return false;
+    }
+    BasicMoveableObject<T> seen = puck;
+    seen.pos = *seenPos;
+    if (!CalculateCollisionResponse(player, seen)) return false;
+    puck.velocity = seen.velocity;
+    puck.restTicks = 0;
+    player.restTicks = 0;
+    return true;
+  }
+
+  // Ticks an input can reach back, the current one included.
+  [[nodiscard]]
+  std::size_t WindowTicks() const {
+    return samples_.size();
+  }
+
+ private:
+  struct Sample {
+    std::uint64_t tick{~std::uint64_t{0}};
+    Vector pos{};
+  };
+
+  [[nodiscard]]
+  std::uint64_t OldestInWindow() const {
+    return newest_ < samples_.size() ? 0 : newest_ - samples_.size() + 1;
+  }
+
+  std::vector<Sample> samples_;
+  std::uint64_t newest_{0};
+  bool bHasTicks_{false};
+};
+
+using LagCompensator = BasicLagCompensator<Real>;
+
+}  // namespace mp
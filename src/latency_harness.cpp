@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bot_client.hpp"
+#include "cereal/external/rapidjson/ostreamwrapper.h"
+#include "cereal/external/rapidjson/prettywriter.h"
+#include "impaired_transport.hpp"
+#include "loopback_server.hpp"
+#include "loopback_transport.hpp"
+#include "realtime_tick.hpp"
+
+// Input-to-visible latency: bots press keys at random moments and time how
+// long until a received snapshot echoes the input's sequence number. Every
+// combination of tick rate, client send policy and network profile runs
+// against an in-process server, and the distributions go out as JSON.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint16_t kHarnessPort = 5000;
+
+struct NetworkProfile {
+  std::string name;
+  std::string spec;  // ImpairmentProfile, applied in both directions
+};
+
+const std::vector<NetworkProfile> kBuiltinProfiles = {
+    {"none", ""},
+    {"lan", "latency=1"},
+    {"wifi", "latency=5,jitter=10,loss=0.01"},
+    {"mobile", "latency=40,jitter=20,loss=0.02,burst=0.01:0.3"},
+};
+
+struct HarnessOptions {
+  std::vector<int> tickRates{30, 60, 100};
+  // 0 sends every press at once, N latches presses into N Hz send slots
+  std::vector<int> sendRates{0, 30};
+  std::vector<NetworkProfile> profiles{kBuiltinProfiles};
+  std::size_t botCount{4};
+  std::chrono::seconds duration{3};
+  std::chrono::milliseconds meanPressInterval{100};
+  std::uint64_t seed{1};
+  std::string outputPath;  // empty: stdout
+};
+
+std::vector<int> ParseIntList(const std::string_view list) {
+  std::vector<int> values;
+  std::size_t begin = 0;
+  while (begin < list.size()) {
+    const std::size_t end = std::min(list.find(',', begin), list.size());
+    values.push_back(std::stoi(std::string(list.substr(begin, end - begin))));
+    begin = end + 1;
+  }
+  return values;
+}
+
+// "wifi,lan" picks built-in profiles, "name:spec" defines one inline; lists
+// of either are separated by ';'.
+std::vector<NetworkProfile> ParseProfiles(const std::string_view list) {
+  std::vector<NetworkProfile> profiles;
+  std::size_t begin = 0;
+  while (begin < list.size()) {
+    std::size_t end = list.find(';', begin);
+    if (end == std::string_view::npos) end = list.size();
+    const std::string_view item = list.substr(begin, end - begin);
+    begin = end + 1;
+    if (const std::size_t colon = item.find(':');
+        colon != std::string_view::npos) {
+      profiles.push_back({std::string(item.substr(0, colon)),
+                          std::string(item.substr(colon + 1))});
+      continue;
+    }
+    for (std::size_t nameBegin = 0; nameBegin < item.size();) {
+      const std::size_t nameEnd =
+          std::min(item.find(',', nameBegin), item.size());
+      const std::string_view name = item.substr(nameBegin, nameEnd - nameBegin);
+      nameBegin = nameEnd + 1;
+      const auto it =
+          std::find_if(kBuiltinProfiles.begin(), kBuiltinProfiles.end(),
+                       [name](const auto& p) { return p.name == name; });
+      if (it == kBuiltinProfiles.end()) {
+        throw std::runtime_error("Unknown network profile: " +
+                                 std::string(name));
+      }
+      profiles.push_back(*it);
+    }
+  }
+  return profiles;
+}
+
+HarnessOptions ParseOptions(const int argc, char* argv[]) {
+  HarnessOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    if (arg == "--tick-hz") {
+      options.tickRates = ParseIntList(value());
+    } else if (arg == "--send-hz") {
+      options.sendRates = ParseIntList(value());
+    } else if (arg == "--profiles") {
+      options.profiles = ParseProfiles(value());
+    } else if (arg == "--bots") {
+      options.botCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--seconds") {
+      options.duration = std::chrono::seconds(std::max(1, std::atoi(value())));
+    } else if (arg == "--press-ms") {
+      options.meanPressInterval =
+          std::chrono::milliseconds(std::max(1, std::atoi(value())));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--out") {
+      options.outputPath = value();
+    } else {
+      throw std::runtime_error(
+          "Usage: latency_harness [--tick-hz 30,60] [--send-hz 0,30] "
+          "[--profiles none,wifi;name:spec] [--bots n] [--seconds s] "
+          "[--press-ms mean] [--seed n] [--out file.json]");
+    }
+  }
+  return options;
+}
+
+struct RunResult {
+  int tickHz;
+  int sendHz;
+  std::string profile;
+  std::uint64_t presses{0};
+  std::uint64_t unacked{0};
+  double sumMs{0};
+  mp::LatenessHistogram latency;
+};
+
+// A bot plus the presses it is still waiting to see.
+struct Probe {
+  std::unique_ptr<mp::LoopbackTransport> transport;
+  std::unique_ptr<mp::ImpairedTransport> impaired;
+  std::unique_ptr<mp::BotClient> bot;
+  struct Press {
+    std::uint32_t sequence;
+    Clock::time_point at;
+  };
+  std::deque<Press> inFlight;
+  std::optional<Clock::time_point> latchedPress;
+  Clock::time_point nextPress;
+  Clock::time_point nextSendSlot;
+
+  mp::Transport& Net() {
+    if (impaired) return *impaired;
+    return *transport;
+  }
+};
+
+RunResult Run(const HarnessOptions& options, const int tickHz,
+              const int sendHz, const NetworkProfile& profile) {
+  RunResult result{.tickHz = tickHz, .sendHz = sendHz, .profile = profile.name};
+
+  mp::LoopbackNetwork network;
+  mp::LoopbackServer server(network, kHarnessPort,
+                            std::chrono::microseconds(1'000'000 / tickHz));
+  std::atomic<bool> bIsServerRunning = true;
+  std::jthread serverThread([&] { server.Run(bIsServerRunning); });
+  // runs before the join, also when a run throws
+  struct StopServer {
+    std::atomic<bool>& bIsRunning;
+    ~StopServer() { bIsRunning = false; }
+  } stopServer{bIsServerRunning};
+
+  std::mt19937_64 rng(options.seed);
+  std::exponential_distribution<double> pressGap(
+      1.0 / static_cast<double>(options.meanPressInterval.count()));
+  const auto nextGap = [&] {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::milli>(pressGap(rng)));
+  };
+  const std::chrono::microseconds sendPeriod(sendHz ? 1'000'000 / sendHz : 0);
+
+  std::vector<Probe> probes(options.botCount);
+  for (std::size_t i = 0; i < probes.size(); ++i) {
+    Probe& probe = probes[i];
+    probe.transport = std::make_unique<mp::LoopbackTransport>(network);
+    if (!profile.spec.empty()) {
+      const mp::ImpairmentProfile impairment =
+          mp::ParseImpairmentProfile(profile.spec);
+      probe.impaired = std::make_unique<mp::ImpairedTransport>(
+          *probe.transport,
+          mp::ImpairmentConfig{.outbound = impairment,
+                               .inbound = impairment,
+                               .seed = options.seed + i});
+    }
+    // inputs only go out through SendInput, never on the bot's own timer
+    probe.bot = std::make_unique<mp::BotClient>(
+        static_cast<std::uint32_t>(i), mp::BotInputMode::Random,
+        std::chrono::hours(1), options.seed);
+    probe.bot->Connect(probe.Net(), "loopback", kHarnessPort);
+  }
+
+  mp::TransportEvent event;
+  Clock::time_point start = Clock::now();
+  const auto pump = [&](const Clock::time_point now) {
+    for (Probe& probe : probes) {
+      while (probe.Net().Poll(event)) probe.bot->OnEvent(event, now);
+    }
+  };
+  // wait until everybody is seated before measuring
+  while (!std::all_of(probes.begin(), probes.end(),
+                      [](const Probe& p) { return p.bot->HasJoined(); })) {
+    if (Clock::now() - start > std::chrono::seconds(10)) {
+      throw std::runtime_error("Bots failed to join");
+    }
+    pump(Clock::now());
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  start = Clock::now();
+  for (Probe& probe : probes) {
+    probe.nextPress = start + nextGap();
+    probe.nextSendSlot = start;
+  }
+  const Clock::time_point end = start + options.duration;
+  for (Clock::time_point now = start; now < end; now = Clock::now()) {
+    pump(now);
+    for (Probe& probe : probes) {
+      const std::uint32_t acked = probe.bot->AckedInput();
+      while (!probe.inFlight.empty() &&
+             probe.inFlight.front().sequence <= acked) {
+        const auto latency = now - probe.inFlight.front().at;
+        result.latency.Record(latency);
+        result.sumMs +=
+            std::chrono::duration<double, std::milli>(latency).count();
+        probe.inFlight.pop_front();
+      }
+
+      if (now >= probe.nextPress) {
+        result.presses++;
+        probe.nextPress += nextGap();
+        if (!probe.latchedPress) probe.latchedPress = now;
+      }
+      if (probe.latchedPress && (sendHz == 0 || now >= probe.nextSendSlot)) {
+        const float angle = static_cast<float>(result.presses);
+        const std::uint32_t sequence =
+            probe.bot->SendInput(probe.Net(), {std::cos(angle), std::sin(angle)});
+        probe.inFlight.push_back({sequence, *probe.latchedPress});
+        probe.latchedPress.reset();
+        probe.Net().Flush();
+      }
+      if (sendHz != 0 && now >= probe.nextSendSlot) {
+        probe.nextSendSlot += sendPeriod;
+        if (probe.nextSendSlot < now) probe.nextSendSlot = now + sendPeriod;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  for (const Probe& probe : probes) {
+    result.unacked += probe.inFlight.size() + (probe.latchedPress ? 1 : 0);
+  }
+
+  return result;
+}
+
+template <typename Writer>
+void WriteResult(Writer& writer, const RunResult& result) {
+  const auto ms = [](const std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double, std::milli>(ns).count();
+  };
+  const std::uint64_t samples = result.latency.Count();
+  writer.StartObject();
+  writer.Key("tickHz");
+  writer.Int(result.tickHz);
+  writer.Key("sendPolicy");
+  writer.String(result.sendHz ? ("fixed-" + std::to_string(result.sendHz) +
+                                 "hz").c_str()
+                              : "immediate");
+  writer.Key("profile");
+  writer.String(result.profile.c_str());
+  writer.Key("presses");
+  writer.Uint64(result.presses);
+  writer.Key("samples");
+  writer.Uint64(samples);
+  writer.Key("unacked");
+  writer.Uint64(result.unacked);
+  writer.Key("meanMs");
+  writer.Double(samples ? result.sumMs / static_cast<double>(samples) : 0.0);
+  for (const auto& [key, percentile] :
+       {std::pair<const char*, double>{"p50Ms", 50}, {"p90Ms", 90},
+        {"p99Ms", 99}, {"p999Ms", 99.9}}) {
+    writer.Key(key);
+    writer.Double(ms(result.latency.Percentile(percentile)));
+  }
+  writer.Key("maxMs");
+  writer.Double(ms(result.latency.Max()));
+  writer.EndObject();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const HarnessOptions options = ParseOptions(argc, argv);
+
+  std::vector<RunResult> results;
+  for (const int tickHz : options.tickRates) {
+    for (const int sendHz : options.sendRates) {
+      for (const NetworkProfile& profile : options.profiles) {
+        results.push_back(Run(options, tickHz, sendHz, profile));
+        const RunResult& result = results.back();
+        std::cerr << "tick " << tickHz << " Hz, send "
+                  << (sendHz ? std::to_string(sendHz) + " Hz" : "immediate")
+                  << ", " << profile.name << ": p50 "
+                  << std::chrono::duration<double, std::milli>(
+                         result.latency.Percentile(50))
+                         .count()
+                  << " ms, p99 "
+                  << std::chrono::duration<double, std::milli>(
+                         result.latency.Percentile(99))
+                         .count()
+                  << " ms\n";
+      }
+    }
+  }
+
+  std::ofstream file;
+  if (!options.outputPath.empty()) {
+    file.open(options.outputPath);
+    if (!file) throw std::runtime_error("Failed to open " + options.outputPath);
+  }
+  std::ostream& out = options.outputPath.empty() ? std::cout : file;
+  rapidjson::OStreamWrapper stream(out);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  writer.StartObject();
+  writer.Key("bots");
+  writer.Uint64(options.botCount);
+  writer.Key("secondsPerRun");
+  writer.Int64(options.duration.count());
+  writer.Key("meanPressIntervalMs");
+  writer.Int64(options.meanPressInterval.count());
+  writer.Key("seed");
+  writer.Uint64(options.seed);
+  writer.Key("runs");
+  writer.StartArray();
+  for (const RunResult& result : results) WriteResult(writer, result);
+  writer.EndArray();
+  writer.EndObject();
+  out << "\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace mp {
+
+class UniqueFd final {
+ public:
+  UniqueFd() = default;
+  explicit UniqueFd(const int fd) : fd_(fd) {}
+  UniqueFd(const UniqueFd& other) = delete;
+  UniqueFd& operator=(const UniqueFd& other) = delete;
+  UniqueFd(UniqueFd&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+  UniqueFd& operator=(UniqueFd&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+  ~UniqueFd() {
+    if (fd_ >= 0) close(fd_);
+  }
+
+  [[nodiscard]]
+  int Get() const {
+    return fd_;
+  }
+
+ private:
+  int fd_{-1};
+};
+
+inline timespec ToTimespec(const std::chrono::nanoseconds value) {
+  return {
+      .tv_sec = static_cast<time_t>(value.count() / 1'000'000'000),
+      .tv_nsec = static_cast<long>(value.count() % 1'000'000'000),
+  };
+}
+
+// Readiness loop over a handful of descriptors. Wait() blocks in a single
+// epoll_wait and then runs the callbacks of every ready descriptor.
+class EpollLoop final {
+ public:
+  using Callback = std::function<void()>;
+
+  EpollLoop() : epoll_(epoll_create1(EPOLL_CLOEXEC)) {
+    if (epoll_.Get() < 0) {
+      throw std::runtime_error("Failed to create epoll instance");
+    }
+  }
+
+  void Watch(const int fd, Callback onReadable) {
+    epoll_event event{.events = EPOLLIN, .data = {.fd = fd}};
+    if (epoll_ctl(epoll_.Get(), EPOLL_CTL_ADD, fd, &event) != 0) {
+      throw std::runtime_error("Failed to add descriptor to epoll");
+    }
+    callbacks_[fd] = std::move(onReadable);
+  }
+
+  void Unwatch(const int fd) {
+    epoll_ctl(epoll_.Get(), EPOLL_CTL_DEL, fd, nullptr);
+    callbacks_.erase(fd);
+  }
+
+  // `timeoutMs` < 0 sleeps until something is ready.
+  void Wait(const int timeoutMs = -1) {
+    std::array<epoll_event, 16> events;
+    const int ready = epoll_wait(epoll_.Get(), events.data(),
+                                 static_cast<int>(events.size()), timeoutMs);
+    if (ready < 0) {
+      if (errno == EINTR) return;
+      throw std::runtime_error("epoll_wait failed");
+    }
+    for (int i = 0; i < ready; ++i) {
+      if (const auto it = callbacks_.find(events[i].data.fd);
+          it != callbacks_.end()) {
+        it->second();
+      }
+    }
+  }
+
+ private:
+  UniqueFd epoll_;
+  std::unordered_map<int, Callback> callbacks_;
+};
+
+// Periodic monotonic timer on an absolute schedule: deadline N is
+// start + N * period. With a `lead` the descriptor becomes readable that much
+// before each deadline, leaving the caller room to spin up to it.
+class TickTimer final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TickTimer(const std::chrono::nanoseconds period,
+                     const std::chrono::nanoseconds lead = {})
+      : timer_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+        start_(Clock::now()),
+        period_(period) {
+    if (timer_.Get() < 0) {
+      throw std::runtime_error("Failed to create timerfd");
+    }
+    // steady_clock is CLOCK_MONOTONIC, so its epoch matches the timer's
+    const itimerspec spec{
+        .it_interval = ToTimespec(period),
+        .it_value = ToTimespec(start_.time_since_epoch() + period - lead),
+    };
+    if (timerfd_settime(timer_.Get(), TFD_TIMER_ABSTIME, &spec, nullptr) !=
+        0) {
+      throw std::runtime_error("Failed to arm timerfd");
+    }
+  }
+
+  [[nodiscard]]
+  int Fd() const {
+    return timer_.Get();
+  }
+
+  // Number of periods elapsed since the last call, 0 if none.
+  std::uint64_t Expirations() {
+    std::uint64_t expirations = 0;
+    if (read(timer_.Get(), &expirations, sizeof(expirations)) !=
+        sizeof(expirations)) {
+      return 0;
+    }
+    elapsedTicks_ += expirations;
+    return expirations;
+  }
+
+  // Deadline of the most recent expiration.
+  [[nodiscard]]
+  Clock::time_point Deadline() const {
+    return start_ + period_ * static_cast<std::int64_t>(elapsedTicks_);
+  }
+
+ private:
+  UniqueFd timer_;
+  Clock::time_point start_;
+  std::chrono::nanoseconds period_;
+  std::uint64_t elapsedTicks_{0};
+};
+
+// One-shot monotonic timer for a deadline that keeps moving, such as the
+// next packet an ImpairedTransport holds back. Arming it again replaces the
+// deadline; the descriptor stays readable until Acknowledge.
+class DeadlineTimer final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  DeadlineTimer()
+      : timer_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    if (timer_.Get() < 0) {
+      throw std::runtime_error("Failed to create timerfd");
+    }
+  }
+
+  [[nodiscard]]
+  int Fd() const {
+    return timer_.Get();
+  }
+
+  // A deadline already past fires right away.
+  void Arm(const Clock::time_point deadline) {
+    if (armed_ == deadline) return;
+    // a zero it_value would disarm instead
+    const auto since = std::max(deadline.time_since_epoch(),
+                                Clock::duration{std::chrono::nanoseconds{1}});
+    Set({.it_interval = {}, .it_value = ToTimespec(since)});
+    armed_ = deadline;
+  }
+
+  void Disarm() {
+    if (!armed_) return;
+    Set({});
+    armed_.reset();
+  }
+
+  // Consumes the expiration; the timer is disarmed afterwards.
+  void Acknowledge() {
+    std::uint64_t expirations = 0;
+    [[maybe_unused]] const auto bytes =
+        read(timer_.Get(), &expirations, sizeof(expirations));
+    armed_.reset();
+  }
+
+ private:
+  void Set(const itimerspec& spec) {
+    if (timerfd_settime(timer_.Get(), TFD_TIMER_ABSTIME, &spec, nullptr) !=
+        0) {
+      throw std::runtime_error("Failed to arm timerfd");
+    }
+  }
+
+  UniqueFd timer_;
+  std::optional<Clock::time_point> armed_;
+};
+
+enum ControlMessage : std::uint32_t {
+  kControlStop = 1u << 0,
+  kControlPrintStats = 1u << 1,
+  kControlMailbox = 1u << 2,
+};
+
+// Wakes the loop from other threads or from signal handlers. Messages are
+// bit flags, so repeated posts of the same message coalesce.
+class ControlChannel final {
+ public:
+  ControlChannel() : event_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (event_.Get() < 0) {
+      throw std::runtime_error("Failed to create eventfd");
+    }
+  }
+
+  // Async-signal-safe.
+  void Post(const std::uint32_t messages) {
+    pending_.fetch_or(messages, std::memory_order_release);
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const auto written = write(event_.Get(), &one, sizeof(one));
+  }
+
+  // Returns every message posted since the previous call.
+  std::uint32_t Drain() {
+    std::uint64_t counter = 0;
+    [[maybe_unused]] const auto bytes =
+        read(event_.Get(), &counter, sizeof(counter));
+    return pending_.exchange(0, std::memory_order_acquire);
+  }
+
+  [[nodiscard]]
+  int Fd() const {
+    return event_.Get();
+  }
+
+ private:
+  UniqueFd event_;
+  std::atomic<std::uint32_t> pending_{0};
+};
+
+}  // namespace mp
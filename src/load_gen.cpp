@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bot_client.hpp"
+#include "impaired_transport.hpp"
+#include "loopback_server.hpp"
+#include "loopback_transport.hpp"
+#include "realtime_tick.hpp"
+#ifdef MP_HAS_ENET
+#include "enet_transport.hpp"
+#endif
+
+// Puts N headless players on a server from a handful of threads. Against a
+// real server it goes through ENet; with --loopback it runs the rooms
+// in-process over the loopback transport, which takes the kernel out of the
+// picture and measures the server's cpu cost per player.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions {
+  std::string host{"127.0.0.1"};
+  std::uint16_t port{5000};
+  std::size_t clientCount{100};
+  std::size_t threadCount{2};
+  // ENet peers sharing one client socket; more sockets spread the flows
+  // over the server's SO_REUSEPORT workers
+  std::size_t botsPerSocket{16};
+  std::chrono::seconds duration{10};
+  std::chrono::microseconds inputPeriod{33'333};
+  mp::BotInputMode inputMode{mp::BotInputMode::Random};
+  std::uint64_t seed{1};
+  bool bUseLoopback{false};
+  std::chrono::microseconds tickPeriod{10'000};
+  std::optional<mp::ImpairmentConfig> impairment;
+};
+
+LoadOptions ParseOptions(const int argc, char* argv[]) {
+  LoadOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    const auto impairment = [&]() -> mp::ImpairmentConfig& {
+      return options.impairment ? *options.impairment
+                                : options.impairment.emplace();
+    };
+    if (arg == "--host") {
+      options.host = value();
+    } else if (arg == "--port") {
+      options.port = static_cast<std::uint16_t>(std::atoi(value()));
+    } else if (arg == "--clients") {
+      options.clientCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--threads") {
+      options.threadCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--bots-per-socket") {
+      options.botsPerSocket = std::max(1, std::atoi(value()));
+    } else if (arg == "--seconds") {
+      options.duration = std::chrono::seconds(std::atoi(value()));
+    } else if (arg == "--input-hz") {
+      options.inputPeriod = std::chrono::microseconds(
+          1'000'000 / std::max(1, std::atoi(value())));
+    } else if (arg == "--script") {
+      options.inputMode = mp::BotInputMode::Script;
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--loopback") {
+      options.bUseLoopback = true;
+    } else if (arg == "--tick-us") {
+      options.tickPeriod = std::chrono::microseconds(std::atoll(value()));
+    } else if (arg == "--impair-out") {
+      impairment().outbound = mp::ParseImpairmentProfile(value());
+    } else if (arg == "--impair-in") {
+      impairment().inbound = mp::ParseImpairmentProfile(value());
+    } else {
+      throw std::runtime_error(
+          "Usage: load_gen [--host ip] [--port port] [--clients n] "
+          "[--threads n] [--bots-per-socket n] [--seconds s] [--input-hz n] "
+          "[--script] [--seed n] [--loopback] [--tick-us period] "
+          "[--impair-out spec] [--impair-in spec]");
+    }
+  }
+#ifndef MP_HAS_ENET
+  if (!options.bUseLoopback) {
+    throw std::runtime_error("Built without ENet, only --loopback works");
+  }
+#endif
+  return options;
+}
+
+// Totals a thread publishes for the reporting thread.
+struct SharedTraffic {
+  std::atomic<std::uint64_t> joined{0};
+  std::atomic<std::uint64_t> snapshots{0};
+  std::atomic<std::uint64_t> bytesReceived{0};
+  std::atomic<std::uint64_t> bytesSent{0};
+  std::atomic<std::uint64_t> inputsSent{0};
+  std::atomic<std::uint64_t> disconnects{0};
+};
+
+// One client socket and the bots multiplexed on it.
+struct ClientSocket {
+  std::unique_ptr<mp::Transport> transport;
+  std::unique_ptr<mp::ImpairedTransport> impaired;
+#ifdef MP_HAS_ENET
+  mp::EnetTransport* enet{nullptr};
+#endif
+  std::unordered_map<mp::PeerId, mp::BotClient*> bots;
+
+  mp::Transport& Net() {
+    return impaired ? *impaired : *transport;
+  }
+};
+
+void RunClients(const LoadOptions& options, mp::LoopbackNetwork& network,
+                const std::size_t firstBot, const std::size_t botCount,
+                const std::atomic<bool>& bIsRunning, SharedTraffic& shared,
+                mp::LatenessHistogram& roundTrips) {
+  std::vector<std::unique_ptr<mp::BotClient>> bots;
+  std::vector<ClientSocket> sockets;
+  for (std::size_t i = 0; i < botCount; ++i) {
+    if (i % options.botsPerSocket == 0) {
+      ClientSocket& socket = sockets.emplace_back();
+      if (options.bUseLoopback) {
+        socket.transport = std::make_unique<mp::LoopbackTransport>(network);
+      } else {
+#ifdef MP_HAS_ENET
+        auto enet = std::make_unique<mp::EnetTransport>(
+            nullptr, options.botsPerSocket, 2);
+        socket.enet = enet.get();
+        socket.transport = std::move(enet);
+#endif
+      }
+      if (options.impairment) {
+        mp::ImpairmentConfig config = *options.impairment;
+        config.seed = options.seed + firstBot + i;
+        socket.impaired = std::make_unique<mp::ImpairedTransport>(
+            *socket.transport, config);
+      }
+    }
+    const auto index = static_cast<std::uint32_t>(firstBot + i);
+    auto& bot = bots.emplace_back(std::make_unique<mp::BotClient>(
+        index, options.inputMode, options.inputPeriod, options.seed));
+    ClientSocket& socket = sockets.back();
+    bot->Connect(socket.Net(), options.host, options.port);
+    if (bot->Peer() == mp::kInvalidPeerId) {
+      throw std::runtime_error("Failed to start a connection");
+    }
+    socket.bots[bot->Peer()] = bot.get();
+  }
+
+  mp::TransportEvent event;
+  Clock::time_point nextSample = Clock::now();
+  while (bIsRunning.load(std::memory_order_relaxed)) {
+    const Clock::time_point now = Clock::now();
+    for (ClientSocket& socket : sockets) {
+      while (socket.Net().Poll(event)) {
+        if (const auto it = socket.bots.find(event.peer);
+            it != socket.bots.end()) {
+          it->second->OnEvent(event, now);
+        }
+      }
+      for (const auto& [peer, bot] : socket.bots) {
+        bot->Update(socket.Net(), now);
+      }
+      socket.Net().Flush();
+    }
+
+    if (now >= nextSample) {
+      nextSample = now + std::chrono::milliseconds(100);
+      mp::BotTraffic total;
+      std::uint64_t joined = 0;
+      for (const auto& bot : bots) {
+        const mp::BotTraffic& traffic = bot->Traffic();
+        total.snapshots += traffic.snapshots;
+        total.bytesReceived += traffic.bytesReceived;
+        total.bytesSent += traffic.bytesSent;
+        total.inputsSent += traffic.inputsSent;
+        total.disconnects += traffic.disconnects;
+        joined += bot->HasJoined();
+      }
+      shared.joined.store(joined, std::memory_order_relaxed);
+      shared.snapshots.store(total.snapshots, std::memory_order_relaxed);
+      shared.bytesReceived.store(total.bytesReceived,
+                                 std::memory_order_relaxed);
+      shared.bytesSent.store(total.bytesSent, std::memory_order_relaxed);
+      shared.inputsSent.store(total.inputsSent, std::memory_order_relaxed);
+      shared.disconnects.store(total.disconnects, std::memory_order_relaxed);
+#ifdef MP_HAS_ENET
+      for (const ClientSocket& socket : sockets) {
+        if (!socket.enet) continue;
+        for (const auto& [peer, bot] : socket.bots) {
+          if (!bot->HasJoined()) continue;
+          roundTrips.Record(
+              std::chrono::milliseconds(socket.enet->RoundTripTimeMs(peer)));
+        }
+      }
+#else
+      (void)roundTrips;
+#endif
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  for (ClientSocket& socket : sockets) {
+    for (const auto& [peer, bot] : socket.bots) {
+      if (bot->IsConnected()) socket.Net().Disconnect(peer);
+    }
+    socket.Net().Flush();
+  }
+}
+
+struct TrafficTotals {
+  std::uint64_t joined{0};
+  std::uint64_t snapshots{0};
+  std::uint64_t bytesReceived{0};
+  std::uint64_t bytesSent{0};
+  std::uint64_t inputsSent{0};
+  std::uint64_t disconnects{0};
+};
+
+TrafficTotals Sum(const std::vector<std::unique_ptr<SharedTraffic>>& shared) {
+  TrafficTotals totals;
+  for (const auto& traffic : shared) {
+    totals.joined += traffic->joined.load(std::memory_order_relaxed);
+    totals.snapshots += traffic->snapshots.load(std::memory_order_relaxed);
+    totals.bytesReceived +=
+        traffic->bytesReceived.load(std::memory_order_relaxed);
+    totals.bytesSent += traffic->bytesSent.load(std::memory_order_relaxed);
+    totals.inputsSent += traffic->inputsSent.load(std::memory_order_relaxed);
+    totals.disconnects += traffic->disconnects.load(std::memory_order_relaxed);
+  }
+  return totals;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const LoadOptions options = ParseOptions(argc, argv);
+#ifdef MP_HAS_ENET
+  if (!options.bUseLoopback) {
+    mp::EnetInit();
+    assert(0 == atexit(enet_deinitialize));
+  }
+#endif
+
+  mp::LoopbackNetwork network;
+  std::optional<mp::LoopbackServer> server;
+  if (options.bUseLoopback) {
+    server.emplace(network, options.port, options.tickPeriod);
+  }
+
+  std::atomic<bool> bIsServerRunning = true;
+  std::atomic<bool> bIsRunning = true;
+  std::vector<std::unique_ptr<SharedTraffic>> shared;
+  std::vector<mp::LatenessHistogram> roundTrips(options.threadCount);
+  std::vector<std::jthread> threads;
+  if (server) {
+    threads.emplace_back([&] { server->Run(bIsServerRunning); });
+  }
+  const std::size_t perThread =
+      (options.clientCount + options.threadCount - 1) / options.threadCount;
+  for (std::size_t t = 0; t < options.threadCount; ++t) {
+    const std::size_t first = t * perThread;
+    const std::size_t count = std::min(
+        perThread, options.clientCount - std::min(first, options.clientCount));
+    shared.push_back(std::make_unique<SharedTraffic>());
+    threads.emplace_back([&, t, first, count] {
+      RunClients(options, network, first, count, bIsRunning, *shared[t],
+                 roundTrips[t]);
+    });
+  }
+
+  std::cout << "load_gen: " << options.clientCount << " clients on "
+            << options.threadCount << " threads, "
+            << (options.bUseLoopback ? "loopback" : options.host) << "\n";
+  const Clock::time_point start = Clock::now();
+  TrafficTotals last;
+  std::uint64_t lastTicks = 0;
+  std::uint64_t lastServerSnapshots = 0;
+  std::chrono::nanoseconds lastServerCpu{0};
+  for (int second = 1; second <= options.duration.count(); ++second) {
+    std::this_thread::sleep_until(start + std::chrono::seconds(second));
+    const TrafficTotals now = Sum(shared);
+    std::cout << std::setw(4) << second << "s joined " << std::setw(6)
+              << now.joined << ", snapshots/s " << std::setw(8)
+              << now.snapshots - last.snapshots << ", rx B/s " << std::setw(10)
+              << now.bytesReceived - last.bytesReceived << ", tx B/s "
+              << std::setw(8) << now.bytesSent - last.bytesSent
+              << ", disconnects " << now.disconnects;
+    if (server) {
+      const std::chrono::nanoseconds cpu = server->CpuTime();
+      std::cout << " | server ticks/s " << server->Ticks() - lastTicks
+                << ", snapshots/s "
+                << server->SnapshotsSent() - lastServerSnapshots << ", cpu "
+                << std::fixed << std::setprecision(1)
+                << std::chrono::duration<double>(cpu - lastServerCpu).count() *
+                       100
+                << "%" << std::defaultfloat;
+      lastTicks = server->Ticks();
+      lastServerSnapshots = server->SnapshotsSent();
+      lastServerCpu = cpu;
+    }
+    std::cout << "\n";
+    last = now;
+  }
+
+  bIsRunning = false;
+  for (std::size_t i = server ? 1 : 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  bIsServerRunning = false;
+  threads.clear();
+
+  const TrafficTotals totals = Sum(shared);
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "client-observed: " << std::fixed << std::setprecision(0)
+            << static_cast<double>(totals.snapshots) / seconds
+            << " snapshots/s, "
+            << static_cast<double>(totals.bytesReceived) / seconds
+            << " rx B/s, " << static_cast<double>(totals.bytesSent) / seconds
+            << " tx B/s, " << totals.inputsSent << " inputs, "
+            << totals.disconnects << " disconnects\n"
+            << std::defaultfloat;
+  mp::LatenessHistogram allRoundTrips;
+  for (const auto& histogram : roundTrips) allRoundTrips.Merge(histogram);
+  if (allRoundTrips.Count()) allRoundTrips.Print(std::cout, "rtt");
+  if (server) {
+    const double cpuSeconds =
+        std::chrono::duration<double>(server->CpuTime()).count();
+    std::cout << "server-observed: " << std::fixed << std::setprecision(0)
+              << static_cast<double>(server->SnapshotsSent()) / seconds
+              << " snapshots/s, "
+              << static_cast<double>(server->BytesSent()) / seconds
+              << " tx B/s, " << std::setprecision(1)
+              << cpuSeconds * 1e6 / static_cast<double>(std::max<std::uint64_t>(
+                                        server->Ticks(), 1))
+              << " cpu us/tick, ~" << std::setprecision(0)
+              << static_cast<double>(totals.joined) / (cpuSeconds / seconds)
+              << " players per core\n"
+              << std::defaultfloat;
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
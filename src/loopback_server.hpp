@@ -0,0 +1,180 @@
+#pragma once
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "counter_rng.hpp"
+#include "float_env.hpp"
+#include "loopback_transport.hpp"
+#include "server_core.hpp"
+#include "sim_clock.hpp"
+
+namespace mp {
+
+// In-process stand-in for the Linux server: rooms of WorldState::maxPlayers
+// filled in join order, ticked on one thread. Counters may be read from any
+// thread while it runs. Run paces the ticks on `clock`; a caller driving its
+// own loop calls Step once per tick instead.
+class LoopbackServer final {
+ public:
+  LoopbackServer(const LoopbackServer& other) = delete;
+  LoopbackServer& operator=(const LoopbackServer& other) = delete;
+
+  LoopbackServer(LoopbackNetwork& network, const std::uint16_t port,
+                 const std::chrono::microseconds tickPeriod,
+                 SimClock& clock = SystemClock::Instance(),
+                 const std::uint64_t seed = std::random_device{}())
+      : transport_(network, port),
+        tickPeriod_(tickPeriod),
+        clock_(clock),
+        seed_(seed) {}
+
+  void Run(const std::atomic<bool>& bIsRunning) {
+    SetDenormalFlush(true);
+    const auto cpuStart = ThreadCpuTime();
+    auto deadline = clock_.Now();
+    while (bIsRunning.load(std::memory_order_relaxed)) {
+      Step();
+      cpu_.store((ThreadCpuTime() - cpuStart).count(),
+                 std::memory_order_relaxed);
+      deadline += tickPeriod_;
+      clock_.SleepUntil(deadline);
+    }
+  }
+
+  // Handles pending events, then ticks every room and sends its snapshot.
+  void Step() {
+    Service();
+    for (Room& room : rooms_) {
+      room.server.Tick();
+      const std::string packet = room.server.SerializeWorld();
+      for (const PeerId peer : room.members) {
+        transport_.Send(peer, AsBytes(packet), 0, kPacketReliable);
+      }
+      snapshotsSent_.fetch_add(room.members.size(),
+                               std::memory_order_relaxed);
+      bytesSent_.fetch_add(packet.size() * room.members.size(),
+                           std::memory_order_relaxed);
+    }
+    ticks_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Rooms opened from now on send HashedWorldState snapshots.
+  void SetSnapshotHashes(const bool bIsEnabled) {
+    bHashesSnapshots_ = bIsEnabled;
+  }
+
+  // Rooms are only safe to look at from the thread that steps the server.
+  [[nodiscard]]
+  std::size_t RoomCount() const {
+    return rooms_.size();
+  }
+
+  [[nodiscard]]
+  const GameServer& RoomServer(const std::size_t room) const {
+    return rooms_[room].server;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Ticks() const {
+    return ticks_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]]
+  std::uint64_t SnapshotsSent() const {
+    return snapshotsSent_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]]
+  std::uint64_t BytesSent() const {
+    return bytesSent_.load(std::memory_order_relaxed);
+  }
+
+  // Cpu time the server thread spent in Run so far.
+  [[nodiscard]]
+  std::chrono::nanoseconds CpuTime() const {
+    return std::chrono::nanoseconds(cpu_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  struct Room {
+    Room(const std::uint64_t seed, const std::chrono::microseconds tickPeriod)
+        : server(seed, tickPeriod) {}
+
+    GameServer server;
+    std::vector<PeerId> members;
+  };
+
+  struct Seat {
+    std::size_t room;
+    std::uint32_t playerId;
+  };
+
+  static std::chrono::nanoseconds ThreadCpuTime() {
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) +
+           std::chrono::nanoseconds(time.tv_nsec);
+  }
+
+  void Service() {
+    TransportEvent event;
+    while (transport_.Poll(event)) {
+      switch (event.type) {
+        case TransportEventType::Connect: {
+          auto room = std::find_if(rooms_.begin(), rooms_.end(), [](auto& r) {
+            return r.members.size() < WorldState::maxPlayers;
+          });
+          if (room == rooms_.end()) {
+            rooms_.emplace_back(RoomSeed(seed_, rooms_.size()), tickPeriod_);
+            room = std::prev(rooms_.end());
+            room->server.SetSnapshotHashes(bHashesSnapshots_);
+          }
+          const Player player = room->server.Join();
+          room->members.push_back(event.peer);
+          seats_[event.peer] = {
+              static_cast<std::size_t>(room - rooms_.begin()), player.id};
+          SendPacket(transport_, event.peer, PacketType::Connect,
+                     Player{player});
+        } break;
+        case TransportEventType::Disconnect: {
+          const auto it = seats_.find(event.peer);
+          if (it == seats_.end()) break;
+          Room& room = rooms_[it->second.room];
+          room.server.Leave(it->second.playerId);
+          std::erase(room.members, event.peer);
+          seats_.erase(it);
+        } break;
+        case TransportEventType::Receive:
+          if (const auto it = seats_.find(event.peer); it != seats_.end()) {
+            rooms_[it->second.room].server.Receive(event.data.data(),
+                                                   event.data.size());
+          }
+          break;
+      }
+    }
+  }
+
+  LoopbackTransport transport_;
+  std::chrono::microseconds tickPeriod_;
+  SimClock& clock_;
+  std::uint64_t seed_;
+  bool bHashesSnapshots_{false};
+  std::deque<Room> rooms_;
+  std::unordered_map<PeerId, Seat> seats_;
+  std::atomic<std::uint64_t> ticks_{0};
+  std::atomic<std::uint64_t> snapshotsSent_{0};
+  std::atomic<std::uint64_t> bytesSent_{0};
+  std::atomic<std::int64_t> cpu_{0};
+};
+
+}  // namespace mp
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "transport.hpp"
+
+namespace mp {
+
+class LoopbackTransport;
+
+// In-process "network" shared by loopback transports. Listening transports
+// register under a port and clients connect to that port; the host string is
+// ignored. Delivery is immediate, ordered and lossless on every channel.
+class LoopbackNetwork final {
+ public:
+  LoopbackNetwork() = default;
+  LoopbackNetwork(const LoopbackNetwork& other) = delete;
+  LoopbackNetwork& operator=(const LoopbackNetwork& other) = delete;
+
+ private:
+  friend class LoopbackTransport;
+
+  std::mutex mutex_;
+  std::unordered_map<std::uint16_t, LoopbackTransport*> listeners_;
+};
+
+class LoopbackTransport final : public Transport {
+ public:
+  LoopbackTransport(const LoopbackTransport& other) = delete;
+  LoopbackTransport& operator=(const LoopbackTransport& other) = delete;
+
+  // `port` 0: client only, nobody can connect to this transport.
+  explicit LoopbackTransport(LoopbackNetwork& network,
+                             const std::uint16_t port = 0)
+      : network_(network), port_(port) {
+    if (port_ == 0) return;
+    std::lock_guard lock(network_.mutex_);
+    if (!network_.listeners_.emplace(port_, this).second) {
+      throw std::runtime_error("Loopback port already in use");
+    }
+  }
+
+  ~LoopbackTransport() override {
+    std::lock_guard networkLock(network_.mutex_);
+    if (port_ != 0) network_.listeners_.erase(port_);
+    std::lock_guard lock(mutex_);
+    for (PeerId peer = 0; peer < links_.size(); ++peer) {
+      if (links_[peer].remote) DropLink(peer);
+    }
+  }
+
+  PeerId Connect(const std::string& /*host*/, const std::uint16_t port,
+                 const std::size_t /*channelCount*/) override {
+    std::lock_guard networkLock(network_.mutex_);
+    const auto listener = network_.listeners_.find(port);
+    if (listener == network_.listeners_.end() || listener->second == this) {
+      return kInvalidPeerId;
+    }
+    LoopbackTransport& remote = *listener->second;
+    std::scoped_lock lock(mutex_, remote.mutex_);
+    const PeerId local = AllocateLink();
+    const PeerId accepted = remote.AllocateLink();
+    links_[local] = {&remote, accepted};
+    remote.links_[accepted] = {this, local};
+    PushEvent({TransportEventType::Connect, local}, {});
+    remote.PushEvent({TransportEventType::Connect, accepted}, {});
+    return local;
+  }
+
+  void Send(const PeerId peer, const std::span<const std::uint8_t> data,
+            const std::uint8_t channel, const std::uint32_t flags) override {
+    std::lock_guard networkLock(network_.mutex_);
+    std::unique_lock lock(mutex_);
+    if (peer >= links_.size() || !links_[peer].remote) return;
+    const Link link = links_[peer];
+    lock.unlock();
+    std::lock_guard remoteLock(link.remote->mutex_);
+    link.remote->PushEvent(
+        {TransportEventType::Receive, link.remotePeer, channel, flags}, data);
+  }
+
+  void Broadcast(const std::span<const std::uint8_t> data,
+                 const std::uint8_t channel,
+                 const std::uint32_t flags) override {
+    std::vector<PeerId> peers;
+    {
+      std::lock_guard lock(mutex_);
+      for (PeerId peer = 0; peer < links_.size(); ++peer) {
+        if (links_[peer].remote) peers.push_back(peer);
+      }
+    }
+    for (const PeerId peer : peers) Send(peer, data, channel, flags);
+  }
+
+  bool Poll(TransportEvent& event,
+            const std::uint32_t timeoutMs = 0) override {
+    std::unique_lock lock(mutex_);
+    if (!received_.empty()) {
+      // the previous event's payload is released only now
+      free_.push_back(std::move(received_));
+    }
+    if (events_.empty() && timeoutMs > 0) {
+      eventsChanged_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                              [this] { return !events_.empty(); });
+    }
+    if (events_.empty()) return false;
+
+    Queued& queued = events_.front();
+    event = queued.event;
+    if (event.type == TransportEventType::Disconnect) {
+      closing_[event.peer] = false;
+    }
+    received_ = std::move(queued.data);
+    event.data = received_;
+    events_.pop_front();
+    return true;
+  }
+
+  void Flush() override {}
+
+  void Disconnect(const PeerId peer) override {
+    std::lock_guard networkLock(network_.mutex_);
+    std::lock_guard lock(mutex_);
+    if (peer >= links_.size() || !links_[peer].remote) return;
+    DropLink(peer);
+    PushEvent({TransportEventType::Disconnect, peer}, {});
+  }
+
+  void Reset(const PeerId peer) override {
+    std::lock_guard networkLock(network_.mutex_);
+    std::lock_guard lock(mutex_);
+    if (peer >= links_.size() || !links_[peer].remote) return;
+    DropLink(peer);
+    // no local event follows, the slot is free right away
+    closing_[peer] = false;
+  }
+
+  // Number of peers currently connected.
+  [[nodiscard]]
+  std::size_t PeerCount() const {
+    std::lock_guard lock(mutex_);
+    std::size_t count = 0;
+    for (const Link& link : links_) count += link.remote != nullptr;
+    return count;
+  }
+
+ private:
+  struct Link {
+    LoopbackTransport* remote{nullptr};
+    PeerId remotePeer{kInvalidPeerId};
+  };
+
+  struct Queued {
+    TransportEvent event;
+    std::vector<std::uint8_t> data;
+  };
+
+  // Caller holds mutex_.
+  PeerId AllocateLink() {
+    for (PeerId peer = 0; peer < links_.size(); ++peer) {
+      if (!links_[peer].remote && !closing_[peer]) return peer;
+    }
+    links_.emplace_back();
+    closing_.push_back(false);
+    return static_cast<PeerId>(links_.size() - 1);
+  }
+
+  // Caller holds network_.mutex_ and mutex_; takes the remote's lock, which
+  // keeps the network -> local -> remote order every path uses.
+  void DropLink(const PeerId peer) {
+    const Link link = links_[peer];
+    links_[peer] = {};
+    closing_[peer] = true;
+    std::lock_guard remoteLock(link.remote->mutex_);
+    link.remote->links_[link.remotePeer] = {};
+    link.remote->closing_[link.remotePeer] = true;
+    link.remote->PushEvent(
+        {TransportEventType::Disconnect, link.remotePeer}, {});
+  }
+
+  // Caller holds mutex_.
+  void PushEvent(const TransportEvent& event,
+                 const std::span<const std::uint8_t> data) {
+    Queued& queued = events_.emplace_back();
+    queued.event = event;
+    if (!data.empty()) {
+      if (!free_.empty()) {
+        queued.data = std::move(free_.back());
+        free_.pop_back();
+      }
+      queued.data.assign(data.begin(), data.end());
+    }
+    eventsChanged_.notify_one();
+  }
+
+  LoopbackNetwork& network_;
+  std::uint16_t port_;
+  mutable std::mutex mutex_;
+  std::condition_variable eventsChanged_;
+  std::vector<Link> links_;
+  // Dropped but the Disconnect event is still queued: reusing the slot
+  // would attribute that event to the new peer.
+  std::vector<bool> closing_;
+  std::deque<Queued> events_;
+  std::vector<std::uint8_t> received_;
+  std::vector<std::vector<std::uint8_t>> free_;
+};
+
+}  // namespace mp
@@ -21,8 +21,8 @@ namespace std {
 
 constexpr mp::Vector2 clamp(const mp::Vector2 val, const mp::Vector2 min,
                             const mp::Vector2 max) {
-  const float x = std::clamp(val.x, min.x, max.x);
-  const float y = std::clamp(val.y, min.y, max.y);
+  const mp::Real x = std::clamp(val.x, min.x, max.x);
+  const mp::Real y = std::clamp(val.y, min.y, max.y);
   return {x, y};
 }
 }  // namespace std
@@ -75,7 +75,7 @@ void Window::SetWindowTitle(std::string_view title) {
   SetWindowTextA(window_, title.data());
 }
 
-void Window::DrawImage(Gdiplus::Image* image, mp::Vector2 pos,
+void Window::DrawImage(Gdiplus::Image* image, mp::Vector2f pos,
                        const float degree) {
   if (!image) return;
   const int imageWidth = static_cast<int>(image->GetWidth());
@@ -100,7 +100,7 @@ void Window::DrawImage(Gdiplus::Image* image, mp::Vector2 pos,
   graphics.ResetTransform();
 }
 
-void Window::DrawCircle(float radius, mp::Vector2 pos, COLORREF fillColor, COLORREF outlineColor) {
+void Window::DrawCircle(float radius, mp::Vector2f pos, COLORREF fillColor, COLORREF outlineColor) {
   HPEN hPen = CreatePen(PS_SOLID, 3, outlineColor);
   HPEN hOldPen = static_cast<HPEN>(SelectObject(hdc_, hPen));
   const HBRUSH brush = CreateSolidBrush(fillColor);
@@ -114,7 +114,7 @@ void Window::DrawCircle(float radius, mp::Vector2 pos, COLORREF fillColor, COLOR
   DeleteObject(hPen);
 }
 
-void Window::DrawLabel(std::string_view text, mp::Vector2 pos, COLORREF c) {
+void Window::DrawLabel(std::string_view text, mp::Vector2f pos, COLORREF c) {
   const HBRUSH brush = CreateSolidBrush(c);
   SelectObject(hdc_, brush);
   Transform(pos.x, pos.y);
@@ -122,21 +122,22 @@ void Window::DrawLabel(std::string_view text, mp::Vector2 pos, COLORREF c) {
   DeleteObject(brush);
 }
 
-void Window::DrawField(mp::Vector2 leftRight, mp::Vector2 topBottom,
+void Window::DrawField(std::span<const std::array<mp::Vector2f, 2>> walls,
                        COLORREF c) {
   const HPEN pen = CreatePen(PS_SOLID, 4, c);
   auto oldPen = SelectObject(hdc_, pen);
-  SelectObject(hdc_, GetStockObject(NULL_BRUSH));
-  Transform(leftRight.x, topBottom.x);
-  Transform(leftRight.y, topBottom.y);
-
-  RoundRect(hdc_, leftRight.x, topBottom.x, leftRight.y, topBottom.y, 40, 40);
+  for (auto [start, end] : walls) {
+    Transform(start.x, start.y);
+    Transform(end.x, end.y);
+    MoveToEx(hdc_, start.x, start.y, nullptr);
+    LineTo(hdc_, end.x, end.y);
+  }
 
   SelectObject(hdc_, oldPen);
   DeleteObject(pen);
 }
 
-void Window::DrawLine(mp::Vector2 start, mp::Vector2 end, COLORREF c) {
+void Window::DrawLine(mp::Vector2f start, mp::Vector2f end, COLORREF c) {
   HPEN pen = CreatePen(PS_SOLID, 2, c);
   HPEN oldPen = static_cast<HPEN>(SelectObject(hdc_, pen));
   Transform(start.x, start.y);
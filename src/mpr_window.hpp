@@ -4,6 +4,8 @@
 #define NOMINMAX
 #include <Windows.h>
 
+#include <array>
+#include <span>
 #include <string_view>
 #include <queue>
 
@@ -56,17 +58,17 @@ public:
     return window_;
   }
 
-  void DrawImage(Gdiplus::Image* image, mp::Vector2, float degree = 0.0);
+  void DrawImage(Gdiplus::Image* image, mp::Vector2f, float degree = 0.0);
 
-  void DrawCircle(float radius, mp::Vector2 pos,
+  void DrawCircle(float radius, mp::Vector2f pos,
                   COLORREF fillColor = RGB(255, 255, 255), COLORREF outlineColor = RGB(0, 0, 0));
 
-  void DrawLabel(std::string_view text, mp::Vector2 pos, COLORREF c = RGB(255, 255, 255));
+  void DrawLabel(std::string_view text, mp::Vector2f pos, COLORREF c = RGB(255, 255, 255));
 
-  void DrawField(mp::Vector2 leftRight, mp::Vector2 topBottom,
+  void DrawField(std::span<const std::array<mp::Vector2f, 2>> walls,
                  COLORREF c = RGB(255, 255, 255));
 
-  void DrawLine(mp::Vector2 start, mp::Vector2 end,
+  void DrawLine(mp::Vector2f start, mp::Vector2f end,
                 COLORREF c = RGB(255, 255, 255));
 
   bool PollEvent(mp::Event& e);
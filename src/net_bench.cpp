@@ -0,0 +1,319 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "batched_udp.hpp"
+#include "linux_loop.hpp"
+#ifdef MP_HAS_BATCHED_ENET_IO
+#include "enet_transport.hpp"
+#endif
+
+// Loopback UDP throughput of the socket layouts the server can use. Senders
+// spread datagrams over many source ports so the kernel's SO_REUSEPORT hash
+// has flows to distribute between the receiving sockets. With the static
+// ENet build, `enet` also runs an ENet host on the stock and on the batched
+// socket layer.
+
+namespace {
+
+constexpr std::uint16_t kBenchPort = 5999;
+constexpr std::size_t kDatagramSize = 64;
+constexpr std::size_t kSenderThreads = 4;
+constexpr std::size_t kFlowsPerSender = 8;
+
+sockaddr_in LoopbackAddress(const std::uint16_t port) {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return address;
+}
+
+mp::UniqueFd CreateReceiver() {
+  mp::UniqueFd socket(::socket(AF_INET, SOCK_DGRAM, 0));
+  const int enable = 1;
+  const int bufferSize = 4 << 20;
+  const timeval timeout{.tv_sec = 0, .tv_usec = 100'000};
+  setsockopt(socket.Get(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+  setsockopt(socket.Get(), SOL_SOCKET, SO_RCVBUF, &bufferSize,
+             sizeof(bufferSize));
+  setsockopt(socket.Get(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  const sockaddr_in address = LoopbackAddress(kBenchPort);
+  if (bind(socket.Get(), reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0) {
+    throw std::runtime_error("Failed to bind the benchmark port");
+  }
+  return socket;
+}
+
+// One datagram per syscall, the way enet_socket_receive works.
+std::uint64_t ReceiveSingle(const int socket, const std::atomic<bool>& bIsRunning) {
+  std::array<std::uint8_t, 1500> buffer;
+  std::uint64_t received = 0;
+  while (bIsRunning.load(std::memory_order_relaxed)) {
+    if (recv(socket, buffer.data(), buffer.size(), 0) > 0) ++received;
+  }
+  return received;
+}
+
+// Up to kUdpBatchSize datagrams per syscall, the batched ENet socket layer.
+std::uint64_t ReceiveBatched(const int socket,
+                             const std::atomic<bool>& bIsRunning) {
+  mp::UdpReceiveBatch batch(socket);
+  mp::UdpDatagram datagram;
+  std::uint64_t received = 0;
+  while (bIsRunning.load(std::memory_order_relaxed)) {
+    if (batch.Next(datagram) > 0) {
+      ++received;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  return received;
+}
+
+std::chrono::nanoseconds ThreadCpuTime() {
+  timespec time{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return std::chrono::seconds(time.tv_sec) +
+         std::chrono::nanoseconds(time.tv_nsec);
+}
+
+void Send(const std::atomic<bool>& bIsRunning) {
+  std::vector<mp::UniqueFd> flows;
+  for (std::size_t i = 0; i < kFlowsPerSender; ++i) {
+    flows.emplace_back(::socket(AF_INET, SOCK_DGRAM, 0));
+  }
+  const sockaddr_in target = LoopbackAddress(kBenchPort);
+  const std::array<std::uint8_t, kDatagramSize> payload{};
+  while (bIsRunning.load(std::memory_order_relaxed)) {
+    for (const auto& flow : flows) {
+      sendto(flow.Get(), payload.data(), payload.size(), MSG_DONTWAIT,
+             reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+    }
+  }
+}
+
+void BenchmarkReusePort(const std::chrono::seconds duration) {
+  std::cout << "SO_REUSEPORT receive scaling, " << kSenderThreads * kFlowsPerSender
+            << " flows, " << kDatagramSize << " byte datagrams\n";
+  for (const std::size_t socketCount : {1, 2, 4, 8}) {
+    std::vector<mp::UniqueFd> sockets;
+    for (std::size_t i = 0; i < socketCount; ++i) {
+      sockets.push_back(CreateReceiver());
+    }
+
+    std::atomic<bool> bIsRunning = true;
+    std::vector<std::uint64_t> received(socketCount, 0);
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 0; i < socketCount; ++i) {
+      threads.emplace_back([&, i] {
+        received[i] = ReceiveSingle(sockets[i].Get(), bIsRunning);
+      });
+    }
+    for (std::size_t i = 0; i < kSenderThreads; ++i) {
+      threads.emplace_back([&] { Send(bIsRunning); });
+    }
+    std::this_thread::sleep_for(duration);
+    bIsRunning = false;
+    threads.clear();
+
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : received) total += count;
+    const double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << std::setw(2) << socketCount << " sockets: " << std::fixed
+              << std::setprecision(0)
+              << static_cast<double>(total) / seconds << " datagrams/s (";
+    for (std::size_t i = 0; i < socketCount; ++i) {
+      std::cout << (i ? " " : "")
+                << static_cast<double>(received[i]) / seconds;
+    }
+    std::cout << ")\n" << std::defaultfloat;
+  }
+}
+
+struct IoResult {
+  std::uint64_t datagrams{0};
+  std::chrono::nanoseconds cpu{0};
+};
+
+void PrintIoResult(const std::string_view name, const IoResult& result,
+                   const std::chrono::seconds duration) {
+  const double seconds = std::chrono::duration<double>(duration).count();
+  std::cout << std::setw(22) << std::left << name << std::right << std::fixed
+            << std::setprecision(0) << std::setw(12)
+            << static_cast<double>(result.datagrams) / seconds
+            << " datagrams/s, " << std::setprecision(1) << std::setw(7)
+            << static_cast<double>(result.cpu.count()) /
+                   static_cast<double>(std::max<std::uint64_t>(
+                       result.datagrams, 1))
+            << " cpu ns/datagram\n"
+            << std::defaultfloat;
+}
+
+// Stock (one syscall per datagram) against batched I/O on a single socket.
+void BenchmarkBatchedIo(const std::chrono::seconds duration) {
+  std::cout << "Single socket, " << kDatagramSize << " byte datagrams, batch "
+            << mp::kUdpBatchSize << "\n";
+
+  using ReceiveFunction = std::uint64_t (*)(int, const std::atomic<bool>&);
+  for (const auto& [name, receive] :
+       {std::pair<std::string_view, ReceiveFunction>{"recv", ReceiveSingle},
+        {"recvmmsg", ReceiveBatched}}) {
+    mp::UniqueFd socket = CreateReceiver();
+    std::atomic<bool> bIsRunning = true;
+    IoResult result;
+    std::vector<std::jthread> threads;
+    threads.emplace_back([&, receive] {
+      const auto start = ThreadCpuTime();
+      result.datagrams = receive(socket.Get(), bIsRunning);
+      result.cpu = ThreadCpuTime() - start;
+    });
+    for (std::size_t i = 0; i < kSenderThreads; ++i) {
+      threads.emplace_back([&] { Send(bIsRunning); });
+    }
+    std::this_thread::sleep_for(duration);
+    bIsRunning = false;
+    threads.clear();
+    PrintIoResult(name, result, duration);
+  }
+
+  for (const bool bIsBatched : {false, true}) {
+    // a sink nobody reads from: only the send path is measured
+    mp::UniqueFd sink = CreateReceiver();
+    mp::UniqueFd socket(::socket(AF_INET, SOCK_DGRAM, 0));
+    const sockaddr_in target = LoopbackAddress(kBenchPort);
+    const std::array<std::uint8_t, kDatagramSize> payload{};
+    const iovec buffer{.iov_base = const_cast<std::uint8_t*>(payload.data()),
+                       .iov_len = payload.size()};
+    mp::UdpSendBatch batch(socket.Get());
+
+    IoResult result;
+    const auto cpuStart = ThreadCpuTime();
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+      for (std::size_t i = 0; i < mp::kUdpBatchSize; ++i) {
+        if (bIsBatched) {
+          batch.Push(target, {&buffer, 1});
+        } else {
+          sendto(socket.Get(), payload.data(), payload.size(), MSG_DONTWAIT,
+                 reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+        }
+      }
+      if (bIsBatched) batch.Flush();
+      result.datagrams += mp::kUdpBatchSize;
+    }
+    result.cpu = ThreadCpuTime() - cpuStart;
+    PrintIoResult(bIsBatched ? "sendmmsg" : "sendto", result, duration);
+  }
+}
+
+#ifdef MP_HAS_BATCHED_ENET_IO
+constexpr std::uint16_t kEnetBenchPort = 5998;
+
+// One ENet client per flow, each sending unreliable packets flushed one by
+// one so that every packet is a datagram of its own.
+void SendEnet(const std::atomic<bool>& bIsRunning) {
+  std::vector<std::unique_ptr<mp::EnetTransport>> clients;
+  std::vector<mp::PeerId> peers;
+  for (std::size_t i = 0; i < kFlowsPerSender; ++i) {
+    auto& client = clients.emplace_back(
+        std::make_unique<mp::EnetTransport>(nullptr, 1, 1));
+    peers.push_back(client->Connect("127.0.0.1", kEnetBenchPort, 1));
+  }
+  mp::TransportEvent event;
+  for (std::size_t connected = 0; connected < clients.size();) {
+    if (!bIsRunning.load(std::memory_order_relaxed)) return;
+    for (const auto& client : clients) {
+      while (client->Poll(event, 1)) {
+        if (event.type == mp::TransportEventType::Connect) ++connected;
+      }
+    }
+  }
+  const std::array<std::uint8_t, kDatagramSize> payload{};
+  while (bIsRunning.load(std::memory_order_relaxed)) {
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+      clients[i]->Send(peers[i], payload, 0, mp::kPacketUnreliable);
+      while (clients[i]->Poll(event)) {
+      }
+    }
+  }
+}
+
+// A server host serviced the way ServerWorker does, on ENet's own socket
+// calls and on recvmmsg/sendmmsg batches.
+void BenchmarkEnet(const std::chrono::seconds duration) {
+  mp::EnetInit();
+  std::cout << "ENet host, " << kSenderThreads * kFlowsPerSender
+            << " clients, " << kDatagramSize << " byte packets\n";
+  for (const bool bIsBatched : {false, true}) {
+    mp::EnableBatchedEnetIo(bIsBatched);
+    const ENetAddress address = mp::EnetCreateAddress(kEnetBenchPort);
+    mp::EnetTransport server(&address, kSenderThreads * kFlowsPerSender, 1);
+
+    std::atomic<bool> bIsRunning = true;
+    IoResult result;
+    std::vector<std::jthread> threads;
+    threads.emplace_back([&] {
+      const auto start = ThreadCpuTime();
+      mp::TransportEvent event;
+      while (bIsRunning.load(std::memory_order_relaxed)) {
+        while (server.Poll(event)) {
+          if (event.type == mp::TransportEventType::Receive) {
+            ++result.datagrams;
+          }
+        }
+      }
+      result.cpu = ThreadCpuTime() - start;
+    });
+    for (std::size_t i = 0; i < kSenderThreads; ++i) {
+      threads.emplace_back([&] { SendEnet(bIsRunning); });
+    }
+    std::this_thread::sleep_for(duration);
+    bIsRunning = false;
+    threads.clear();
+    PrintIoResult(bIsBatched ? "enet recvmmsg" : "enet stock", result,
+                  duration);
+  }
+  mp::EnableBatchedEnetIo(false);
+  enet_deinitialize();
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const std::string_view mode = argc > 1 ? argv[1] : "reuseport";
+  const std::chrono::seconds duration(argc > 2 ? std::atoi(argv[2]) : 3);
+  if (mode == "reuseport") {
+    BenchmarkReusePort(duration);
+  } else if (mode == "batched") {
+    BenchmarkBatchedIo(duration);
+#ifdef MP_HAS_BATCHED_ENET_IO
+  } else if (mode == "enet") {
+    BenchmarkEnet(duration);
+#endif
+  } else {
+    std::cerr << "Usage: net_bench [reuseport|batched|enet] [seconds]\n";
+    return 1;
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -10,11 +10,13 @@
 
 #include <cassert>
 #include <functional>
+#include <span>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <unordered_map>
 
-#include "enet.h"
+#include "transport.hpp"
 
 // clang-format on
 
@@ -30,7 +32,15 @@ enum class PacketType : std::uint8_t {
   Connect,
   Disconnect,
   PlayerInputUpdate,
+  // a WorldState with its tick, see BasicTickedWorldState
   WorldState,
+  // a WorldState with its tick and hash, see world_hash.hpp
+  HashedWorldState,
+  // a WorldState without the bodies at rest, see resting_snapshot.hpp
+  RestingWorldState,
+  // a PlayerInputUpdate with the tick of the snapshot it was made on, see
+  // lag_compensation.hpp
+  TaggedInputUpdate,
 };
 
 class PacketHandler {
@@ -63,71 +73,48 @@ class PacketHandler {
   std::unordered_map<PacketType, FunctionHandler> bindings_;
 };
 
-inline ENetAddress EnetCreateAddress(const std::uint16_t port,
-                                     const char* addr = "127.0.0.1") {
-  ENetAddress address{.port = port};
-  if (enet_address_set_host_ip(&address, addr) != 0) {
-    throw std::runtime_error("Incorrect ip or port");
-  }
-  return address;
-}
-
-inline void EnetInit() {
-  if (0 != enet_initialize()) {
-    throw std::runtime_error("Failed to init enet");
-  }
-}
-
-inline auto EnetCreateHost(const ENetAddress* address,
-                           const std::size_t numConnections,
-                           const std::size_t numChannels) {
-  static auto hostDeleter = [](ENetHost* host) { enet_host_destroy(host); };
-  return std::unique_ptr<ENetHost, decltype(hostDeleter)>{
-      enet_host_create(address, numConnections, numChannels, 0, 0)};
-}
-
 template <typename T>
   requires(cereal::traits::is_output_serializable<
            T, cereal::PortableBinaryOutputArchive>::value)
-ENetPacket* PreparePacket(PacketType type, T&& data,
-                          const std::uint32_t transferType) {
+std::string SerializePacket(PacketType type, T&& data) {
   std::stringstream ss;
   cereal::PortableBinaryOutputArchive ar(ss);
 
   ar(type);
   ar(std::forward<T>(data));
 
-  const std::string buf = ss.str();
-  return enet_packet_create(buf.data(), buf.size(), transferType);
+  return ss.str();
+}
+
+inline std::span<const std::uint8_t> AsBytes(const std::string& buf) {
+  return {reinterpret_cast<const std::uint8_t*>(buf.data()), buf.size()};
 }
 
 template <typename T>
   requires(cereal::traits::is_output_serializable<
            T, cereal::PortableBinaryOutputArchive>::value)
-void SendPacket(ENetPeer* peer, PacketType type, T&& data,
-                const std::uint32_t transferType = ENET_PACKET_FLAG_RELIABLE,
-                const std::uint32_t channel = 0) {
-  auto* packet = PreparePacket(type, std::forward<T>(data), transferType);
-  assert(packet);
-  enet_peer_send(peer, channel, packet);
+void SendPacket(Transport& transport, PeerId peer, PacketType type, T&& data,
+                const std::uint32_t flags = kPacketReliable,
+                const std::uint8_t channel = 0) {
+  const std::string buf = SerializePacket(type, std::forward<T>(data));
+  transport.Send(peer, AsBytes(buf), channel, flags);
 }
 
 template <typename T>
   requires(cereal::traits::is_output_serializable<
            T, cereal::PortableBinaryOutputArchive>::value)
-void BroadcastPacket(
-    ENetHost* host, PacketType type, T&& data,
-    const std::uint32_t transferType = ENET_PACKET_FLAG_RELIABLE,
-    const std::uint32_t channel = 0) {
-  auto* packet = PreparePacket(type, std::forward<T>(data), transferType);
-  assert(packet);
-  enet_host_broadcast(host, channel, packet);
+void BroadcastPacket(Transport& transport, PacketType type, T&& data,
+                     const std::uint32_t flags = kPacketReliable,
+                     const std::uint8_t channel = 0) {
+  const std::string buf = SerializePacket(type, std::forward<T>(data));
+  transport.Broadcast(AsBytes(buf), channel, flags);
 }
 
-inline void HandlePacket(const ENetPacket* packet, PacketHandler& handler) {
+inline void HandlePacket(const std::uint8_t* data, const std::size_t size,
+                         PacketHandler& handler) {
   std::stringstream ss;
-  ss.write(reinterpret_cast<const char*>(packet->data),
-           static_cast<long long>(packet->dataLength));
+  ss.write(reinterpret_cast<const char*>(data),
+           static_cast<long long>(size));
   PacketHandler::Archive ar(ss);
 
   PacketType type;
@@ -135,4 +122,9 @@ inline void HandlePacket(const ENetPacket* packet, PacketHandler& handler) {
 
   handler.Handle(type, ar);
 }
+
+inline void HandlePacket(const std::span<const std::uint8_t> data,
+                         PacketHandler& handler) {
+  HandlePacket(data.data(), data.size(), handler);
+}
 }  // namespace mp
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mp {
+
+// Log-linear histogram in the spirit of HdrHistogram: every power of two is
+// split into 32 linear sub-buckets, so any recorded value is reported with
+// at most ~3% relative error. Recording is a couple of bit operations and
+// never allocates.
+class LatenessHistogram final {
+ public:
+  void Record(const std::chrono::nanoseconds value) {
+    const std::uint64_t ns =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(value.count(), 0));
+    counts_[BucketIndex(ns)]++;
+    count_++;
+    max_ = std::max(max_, ns);
+  }
+
+  void Reset() { *this = LatenessHistogram{}; }
+
+  void Merge(const LatenessHistogram& other) {
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  [[nodiscard]]
+  std::uint64_t Count() const {
+    return count_;
+  }
+
+  [[nodiscard]]
+  std::chrono::nanoseconds Max() const {
+    return std::chrono::nanoseconds(max_);
+  }
+
+  // `percentile` in [0, 100]; reports the upper bound of the matching bucket.
+  [[nodiscard]]
+  std::chrono::nanoseconds Percentile(const double percentile) const {
+    if (count_ == 0) return {};
+    const auto rank = static_cast<std::uint64_t>(
+        std::max(1.0, percentile / 100.0 * static_cast<double>(count_) + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds(std::min(BucketUpperBound(i), max_));
+      }
+    }
+    return Max();
+  }
+
+  void Print(std::ostream& os, const std::string_view title) const {
+    const auto us = [](const std::chrono::nanoseconds ns) {
+      return std::chrono::duration<double, std::micro>(ns).count();
+    };
+    os << title << " (us) count: " << count_ << std::fixed
+       << std::setprecision(1) << ", p50: " << us(Percentile(50))
+       << ", p90: " << us(Percentile(90)) << ", p99: " << us(Percentile(99))
+       << ", p99.9: " << us(Percentile(99.9))
+       << ", p99.99: " << us(Percentile(99.99)) << ", max: " << us(Max())
+       << std::defaultfloat << "\n";
+  }
+
+ private:
+  static constexpr unsigned kSubBucketBits = 5;
+  static constexpr std::uint64_t kSubBuckets = 1u << kSubBucketBits;
+  static constexpr std::size_t kBuckets =
+      kSubBuckets + (64 - kSubBucketBits) * kSubBuckets;
+
+  static std::size_t BucketIndex(const std::uint64_t value) {
+    if (value < kSubBuckets) return value;
+    const unsigned shift = std::bit_width(value) - 1 - kSubBucketBits;
+    return kSubBuckets + shift * kSubBuckets +
+           ((value >> shift) - kSubBuckets);
+  }
+
+  static std::uint64_t BucketUpperBound(const std::size_t index) {
+    if (index < kSubBuckets) return index;
+    const std::size_t shift = (index - kSubBuckets) / kSubBuckets;
+    const std::uint64_t subBucket = (index - kSubBuckets) % kSubBuckets;
+    return ((kSubBuckets + subBucket + 1) << shift) - 1;
+  }
+
+  std::array<std::uint64_t, kBuckets> counts_{};
+  std::uint64_t count_{0};
+  std::uint64_t max_{0};
+};
+
+struct RealtimeOptions {
+  bool bIsEnabled{false};
+  // sim thread N is pinned to cpus[N % cpus.size()]; empty leaves it floating
+  std::vector<int> cpus;
+  // 0 keeps the default scheduler, otherwise SCHED_FIFO with this priority
+  int fifoPriority{0};
+  // how long before each deadline to stop sleeping and start spinning
+  std::chrono::microseconds spinLead{300};
+};
+
+// Parses "2,3,5" into a cpu list.
+inline std::vector<int> ParseCpuList(const std::string_view list) {
+  std::vector<int> cpus;
+  std::size_t begin = 0;
+  while (begin < list.size()) {
+    const std::size_t end = std::min(list.find(',', begin), list.size());
+    cpus.push_back(std::stoi(std::string(list.substr(begin, end - begin))));
+    begin = end + 1;
+  }
+  return cpus;
+}
+
+inline void ApplyRealtimeOptions(const RealtimeOptions& options,
+                                 const std::size_t simThreadIndex) {
+  if (!options.bIsEnabled) return;
+
+  if (!options.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options.cpus[simThreadIndex % options.cpus.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      throw std::runtime_error("Failed to pin sim thread to its cpu");
+    }
+  }
+
+  if (options.fifoPriority > 0) {
+    const sched_param param{.sched_priority = options.fifoPriority};
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+      throw std::runtime_error(
+          "Failed to switch to SCHED_FIFO (needs CAP_SYS_NICE or rtprio)");
+    }
+  }
+}
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Final stretch of the hybrid wait: the caller has slept until shortly
+// before `deadline` and burns the rest on the cpu, which the kernel timer
+// slack cannot delay.
+inline void SpinUntil(const std::chrono::steady_clock::time_point deadline) {
+  while (std::chrono::steady_clock::now() < deadline) {
+    CpuRelax();
+  }
+}
+
+}  // namespace mp
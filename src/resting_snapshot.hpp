@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "game_data.hpp"
+#include "net_common.hpp"
+
+namespace mp {
+
+// Snapshot that leaves out the bodies that have not moved since the previous
+// one: a sleeping player goes out as its id and a flag, a sleeping puck as
+// the flag alone, and the receiver keeps the copy it already has. It only
+// makes sense on a reliable, ordered channel after a full WorldState, which
+// GameServer sends to a room whenever someone joins.
+//
+// Wire layout: the server tick, the player count, then per player its id, whether it was left out
+// and, if not, teamId, transform and lastInputSequence; then whether the puck
+// was left out, its transform if not, and the goals.
+template <typename T>
+struct BasicRestingWorldState {
+  std::uint64_t tick{0};
+  BasicWorldState<T> world;  // players left out only hold their id
+  std::vector<std::uint8_t> bIsLeftOut;  // per player
+  bool bIsPuckLeftOut{false};
+
+  template <typename Archive>
+  void load(Archive& ar) {
+    std::uint32_t count = 0;
+    ar(tick, count);
+    world.players.resize(count);
+    bIsLeftOut.resize(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      BasicPlayer<T>& player = world.players[i];
+      bool bLeftOut = false;
+      ar(player.id, bLeftOut);
+      bIsLeftOut[i] = bLeftOut;
+      if (!bLeftOut) {
+        ar(player.teamId, player.transform, player.lastInputSequence);
+      }
+    }
+    ar(bIsPuckLeftOut);
+    if (!bIsPuckLeftOut) ar(world.puck.transform);
+    ar(world.goals);
+  }
+
+  // The world this snapshot describes, given the one received before it.
+  [[nodiscard]]
+  BasicWorldState<T> Merge(const BasicWorldState<T>& previous) const {
+    BasicWorldState<T> merged = world;
+    for (std::size_t i = 0; i < merged.players.size(); ++i) {
+      if (!bIsLeftOut[i]) continue;
+      const auto it = std::ranges::find(previous.players,
+                                        merged.players[i].id,
+                                        &BasicPlayer<T>::id);
+      if (it != previous.players.end()) merged.players[i] = *it;
+    }
+    if (bIsPuckLeftOut) merged.puck = previous.puck;
+    return merged;
+  }
+};
+
+using RestingWorldState = BasicRestingWorldState<Real>;
+
+// Writes `world`, as of `tick`, as a RestingWorldState packet, leaving out
+// every body that has rested for at least `leftOutRestTicks` ticks.
+[[nodiscard]]
+inline std::string SerializeRestingWorld(const std::uint64_t tick,
+                                         const WorldState& world,
+                                         const std::uint64_t leftOutRestTicks) {
+  std::stringstream ss;
+  cereal::PortableBinaryOutputArchive ar(ss);
+  ar(PacketType::RestingWorldState);
+  ar(tick, static_cast<std::uint32_t>(world.players.size()));
+  for (const Player& player : world.players) {
+    const bool bLeftOut = player.transform.restTicks >= leftOutRestTicks;
+    ar(player.id, bLeftOut);
+    if (!bLeftOut) {
+      ar(player.teamId, player.transform, player.lastInputSequence);
+    }
+  }
+  const bool bIsPuckLeftOut =
+      world.puck.transform.restTicks >= leftOutRestTicks;
+  ar(bIsPuckLeftOut);
+  if (!bIsPuckLeftOut) ar(world.puck.transform);
+  ar(world.goals);
+  return ss.str();
+}
+
+}  // namespace mp
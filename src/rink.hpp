@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "game_data.hpp"
+
+namespace mp {
+
+// Corners of the default rink, as round as the client used to draw them.
+constexpr float kRinkCornerRadius = .04f;
+
+enum class RinkSegmentKind : std::uint8_t { Line, Arc };
+
+template <typename T>
+struct BasicRinkSegment {
+  RinkSegmentKind kind{RinkSegmentKind::Line};
+  BasicVector2<T> start{};
+  BasicVector2<T> end{};
+  // arcs run the shorter way around it, less than half a turn
+  BasicVector2<T> center{};
+};
+
+// Signed distance to the nearest wall, negative inside the rink, and the
+// direction it grows in: out of the rink, through the nearest wall.
+template <typename T>
+struct BasicRinkContact {
+  T distance{};
+  BasicVector2<T> normal{};
+};
+
+// Rink walls as line and arc segments. They form closed loops; a point is
+// in the rink when a ray from it crosses them an odd number of times, so a
+// loop inside another one is a hole. Exact, but every query walks all the
+// segments; the sim looks walls up in a BasicRinkField baked from it.
+template <typename T>
+class BasicRink {
+ public:
+  using Vector = BasicVector2<T>;
+  using Segment = BasicRinkSegment<T>;
+  using Edge = std::array<Vector, 2>;
+
+  // bisections of an arc for its edges, 2^3 pieces
+  static constexpr int kArcSplits = 3;
+
+  explicit BasicRink(std::vector<Segment> segments)
+      : segments_(std::move(segments)) {
+    for (const Segment& segment : segments_) {
+      if (segment.kind == RinkSegmentKind::Line) {
+        edges_.push_back({segment.start, segment.end});
+      } else {
+        AddArcEdges(segment.center, segment.start, segment.end, kArcSplits);
+      }
+    }
+  }
+
+  // The box spanned by `leftRight` and `topBottom`, its corners rounded to
+  // `cornerRadius`.
+  [[nodiscard]]
+  static BasicRink RoundedBox(const Vector leftRight, const Vector topBottom,
+                              const T cornerRadius) {
+    const T l = leftRight.x;
+    const T r = leftRight.y;
+    const T t = topBottom.x;
+    const T b = topBottom.y;
+    const T c = cornerRadius;
+    using enum RinkSegmentKind;
+    return BasicRink({
+        {Line, {l + c, t}, {r - c, t}, {}},
+        {Arc, {r - c, t}, {r, t + c}, {r - c, t + c}},
+        {Line, {r, t + c}, {r, b - c}, {}},
+        {Arc, {r, b - c}, {r - c, b}, {r - c, b - c}},
+        {Line, {r - c, b}, {l + c, b}, {}},
+        {Arc, {l + c, b}, {l, b - c}, {l + c, b - c}},
+        {Line, {l, b - c}, {l, t + c}, {}},
+        {Arc, {l, t + c}, {l + c, t}, {l + c, t + c}},
+    });
+  }
+
+  [[nodiscard]]
+  const std::vector<Segment>& Segments() const {
+    return segments_;
+  }
+
+  // The walls as straight edges, each arc cut into 2^kArcSplits of them;
+  // what the client draws and what inside tests count crossings of.
+  [[nodiscard]]
+  const std::vector<Edge>& Edges() const {
+    return edges_;
+  }
+
+  // Corners of the box around every edge.
+  [[nodiscard]]
+  Edge Bounds() const {
+    Edge bounds{edges_.front()[0], edges_.front()[0]};
+    for (const Edge& edge : edges_) {
+      for (const Vector& point : edge) {
+        bounds[0] = {std::min(bounds[0].x, point.x),
+                     std::min(bounds[0].y, point.y)};
+        bounds[1] = {std::max(bounds[1].x, point.x),
+                     std::max(bounds[1].y, point.y)};
+      }
+    }
+    return bounds;
+  }
+
+  [[nodiscard]]
+  bool IsInside(const Vector point) const {
+    bool bIsInside = false;
+    for (const auto& [a, b] : edges_) {
+      if ((a.y > point.y) == (b.y > point.y)) continue;
+      const T crossingX = a.x + (point.y - a.y) * (b.x - a.x) / (b.y - a.y);
+      if (point.x < crossingX) bIsInside = !bIsInside;
+    }
+    return bIsInside;
+  }
+
+  // Exact contact against every segment; zero normal on a wall itself.
+  [[nodiscard]]
+  BasicRinkContact<T> Query(const Vector point) const {
+    Vector nearest = NearestPoint(segments_.front(), point);
+    T distance = (point - nearest).Length();
+    for (std::size_t i = 1; i < segments_.size(); ++i) {
+      const Vector candidate = NearestPoint(segments_[i], point);
+      const T candidateDistance = (point - candidate).Length();
+      if (candidateDistance < distance) {
+        nearest = candidate;
+        distance = candidateDistance;
+      }
+    }
+    BasicRinkContact<T> contact;
+    if (distance > 0) contact.normal = (point - nearest) / distance;
+    contact.distance = distance;
+    if (IsInside(point)) {
+      contact.distance = -distance;
+      contact.normal = -contact.normal;
+    }
+    return contact;
+  }
+
+ private:
+  [[nodiscard]]
+  static T Cross(const Vector lhs, const Vector rhs) {
+    return lhs.x * rhs.y - lhs.y * rhs.x;
+  }
+
+  [[nodiscard]]
+  static Vector NearestPoint(const Segment& segment, const Vector point) {
+    if (segment.kind == RinkSegmentKind::Line) {
+      const Vector along = segment.end - segment.start;
+      const T lengthSquared = along.DotProduct(along);
+      if (!(lengthSquared > 0)) return segment.start;
+      const T t = std::clamp<T>(
+          (point - segment.start).DotProduct(along) / lengthSquared, 0, 1);
+      return segment.start + along * t;
+    }
+    const Vector from = segment.start - segment.center;
+    const Vector to = segment.end - segment.center;
+    const Vector offset = point - segment.center;
+    const T turn = Cross(from, to);
+    const bool bIsInWedge =
+        turn > 0 ? Cross(from, offset) >= 0 && Cross(offset, to) >= 0
+                 : Cross(from, offset) <= 0 && Cross(offset, to) <= 0;
+    const T offsetLength = offset.Length();
+    if (bIsInWedge && offsetLength > 0) {
+      return segment.center + offset * (from.Length() / offsetLength);
+    }
+    return (point - segment.start).Length() < (point - segment.end).Length()
+               ? segment.start
+               : segment.end;
+  }
+
+  // Halves the arc until `splits` runs out; the midpoint direction of an arc
+  // under half a turn is the sum of its end directions.
+  void AddArcEdges(const Vector center, const Vector start, const Vector end,
+                   const int splits) {
+    if (splits == 0) {
+      edges_.push_back({start, end});
+      return;
+    }
+    const T radius = (start - center).Length();
+    const Vector middle =
+        center + ((start - center) + (end - center)).Normalize() * radius;
+    AddArcEdges(center, start, middle, splits - 1);
+    AddArcEdges(center, middle, end, splits - 1);
+  }
+
+  std::vector<Segment> segments_;
+  std::vector<Edge> edges_;
+};
+
+// A BasicRink sampled on a grid at load time, each sample holding the signed
+// distance and its gradient, so a body's wall contact is one bilinear
+// lookup whatever the shape. Samples are 1/kCellsPerUnit apart and reach
+// kMarginCells past the walls; points beyond clamp to the outermost ones.
+// Baked in T, so a Fixed field is bit-identical everywhere too.
+template <typename T>
+class BasicRinkField {
+ public:
+  using Vector = BasicVector2<T>;
+
+  static constexpr int kCellsPerUnit = 64;
+  static constexpr int kMarginCells = 8;
+
+  explicit BasicRinkField(const BasicRink<T>& rink) {
+    const auto [low, high] = rink.Bounds();
+    const T margin = T(kMarginCells) / kCellsPerUnit;
+    origin_ = {low.x - margin, low.y - margin};
+    width_ = SampleCount(high.x - low.x);
+    height_ = SampleCount(high.y - low.y);
+    samples_.resize(static_cast<std::size_t>(width_) * height_);
+    for (int y = 0; y < height_; ++y) {
+      for (int x = 0; x < width_; ++x) {
+        At(x, y).distance =
+            rink.Query(origin_ + Vector{T(x) / kCellsPerUnit,
+                                        T(y) / kCellsPerUnit})
+                .distance;
+      }
+    }
+    // gradients from differences of the distances, which stay defined on
+    // the walls and where two walls are equally near
+    for (int y = 0; y < height_; ++y) {
+      for (int x = 0; x < width_; ++x) {
+        const int left = std::max(x - 1, 0);
+        const int right = std::min(x + 1, width_ - 1);
+        const int up = std::max(y - 1, 0);
+        const int down = std::min(y + 1, height_ - 1);
+        const Vector gradient{At(right, y).distance - At(left, y).distance,
+                              At(x, down).distance - At(x, up).distance};
+        const T length = gradient.Length();
+        At(x, y).normal = length > 0 ? gradient / length : Vector{};
+      }
+    }
+  }
+
+  [[nodiscard]]
+  BasicRinkContact<T> Sample(const Vector point) const {
+    const auto [x, tx] = Locate(point.x - origin_.x, width_);
+    const auto [y, ty] = Locate(point.y - origin_.y, height_);
+    const BasicRinkContact<T>* row = &samples_[Index(x, y)];
+    const BasicRinkContact<T>& s00 = row[0];
+    const BasicRinkContact<T>& s10 = row[1];
+    const BasicRinkContact<T>& s01 = row[width_];
+    const BasicRinkContact<T>& s11 = row[width_ + 1];
+    const auto lerp = [](const auto a, const auto b, const T t) {
+      return a + (b - a) * t;
+    };
+    return {lerp(lerp(s00.distance, s10.distance, tx),
+                 lerp(s01.distance, s11.distance, tx), ty),
+            lerp(lerp(s00.normal, s10.normal, tx),
+                 lerp(s01.normal, s11.normal, tx), ty)};
+  }
+
+  [[nodiscard]]
+  std::size_t SampleBytes() const {
+    return samples_.size() * sizeof(BasicRinkContact<T>);
+  }
+
+ private:
+  [[nodiscard]]
+  static int SampleCount(const T span) {
+    return static_cast<int>(ToFloat(span) * kCellsPerUnit) + 2 +
+           2 * kMarginCells;
+  }
+
+  [[nodiscard]]
+  std::size_t Index(const int x, const int y) const {
+    return static_cast<std::size_t>(y) * width_ + x;
+  }
+
+  BasicRinkContact<T>& At(const int x, const int y) {
+    return samples_[Index(x, y)];
+  }
+
+  // Cell of `offset` from the origin along an axis of `samples`, clamped
+  // to the grid, and where in the cell it lies, 0 to 1.
+  [[nodiscard]]
+  static std::pair<int, T> Locate(const T offset, const int samples) {
+    if constexpr (std::is_floating_point_v<T>) {
+      const T cells =
+          std::clamp<T>(offset * kCellsPerUnit, 0, T(samples - 1));
+      const int cell = std::min(static_cast<int>(cells), samples - 2);
+      return {cell, cells - static_cast<T>(cell)};
+    } else {
+      // a cell is a power of two in raw units, so this is shifts and masks
+      constexpr typename T::Raw kCellRaw = T::kOne / kCellsPerUnit;
+      const typename T::Raw raw =
+          std::clamp<typename T::Raw>(offset.RawValue(), 0,
+                                      (samples - 1) * kCellRaw);
+      const int cell = std::min(raw / kCellRaw, samples - 2);
+      return {cell, T::FromRaw((raw - cell * kCellRaw) * kCellsPerUnit)};
+    }
+  }
+
+  Vector origin_{};
+  int width_{0};
+  int height_{0};
+  std::vector<BasicRinkContact<T>> samples_;
+};
+
+using RinkContact = BasicRinkContact<Real>;
+using Rink = BasicRink<Real>;
+using RinkField = BasicRinkField<Real>;
+
+// The rink every room plays in, the old field box with rounded corners.
+template <typename T>
+[[nodiscard]]
+const BasicRink<T>& DefaultRink() {
+  static const BasicRink<T> rink = BasicRink<T>::RoundedBox(
+      BasicWorldState<T>::fieldBorders[0], BasicWorldState<T>::fieldBorders[1],
+      kRinkCornerRadius);
+  return rink;
+}
+
+// Baked on first use, then shared by every room of the process.
+template <typename T>
+[[nodiscard]]
+const BasicRinkField<T>& DefaultRinkField() {
+  static const BasicRinkField<T> field(DefaultRink<T>());
+  return field;
+}
+
+}  // namespace mp
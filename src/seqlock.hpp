@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace mp {
+
+// Single writer, any number of readers. Readers never block the writer and
+// never allocate; a read that overlaps a write is detected by the sequence
+// number and retried. The payload is kept in relaxed atomic words so that
+// concurrent copies are well-defined.
+template <typename T>
+  requires(std::is_trivially_copyable_v<T>)
+class SeqLock {
+ public:
+  SeqLock() = default;
+  explicit SeqLock(const T& value) { Publish(value); }
+
+  SeqLock(const SeqLock& other) = delete;
+  SeqLock& operator=(const SeqLock& other) = delete;
+
+  // Must only be called from the owning writer thread.
+  void Publish(const T& value) {
+    const std::uint64_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto* src = reinterpret_cast<const unsigned char*>(&value);
+    for (std::size_t i = 0; i < kWords; ++i) {
+      std::uint64_t word = 0;
+      std::memcpy(&word, src + i * sizeof(word), WordSize(i));
+      words_[i].store(word, std::memory_order_relaxed);
+    }
+
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Returns false if the value was being written during the copy; `out` is
+  // left in an unspecified (but valid) state in that case.
+  [[nodiscard]]
+  bool TryRead(T& out) const {
+    const std::uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) return false;
+
+    auto* dst = reinterpret_cast<unsigned char*>(&out);
+    for (std::size_t i = 0; i < kWords; ++i) {
+      const std::uint64_t word = words_[i].load(std::memory_order_relaxed);
+      std::memcpy(dst + i * sizeof(word), &word, WordSize(i));
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return before == sequence_.load(std::memory_order_relaxed);
+  }
+
+  void Read(T& out) const {
+    while (!TryRead(out)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // Even values are stable states; it grows by two with every publish.
+  [[nodiscard]]
+  std::uint64_t Sequence() const {
+    return sequence_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr std::size_t kWords =
+      (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+  static constexpr std::size_t WordSize(const std::size_t i) {
+    return i + 1 < kWords ? sizeof(std::uint64_t)
+                          : sizeof(T) - i * sizeof(std::uint64_t);
+  }
+
+  alignas(64) std::atomic<std::uint64_t> sequence_{0};
+  alignas(64) std::array<std::atomic<std::uint64_t>, kWords> words_{};
+};
+
+}  // namespace mp
@@ -0,0 +1,162 @@
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seqlock.hpp"
+#include "shm_world.hpp"
+
+// Torn-read stress test of SeqLock and the shared memory world ring: a
+// writer publishes as fast as it can while readers check that every copy
+// they get back is one whole publish. Each payload is a function of its
+// publish number, so a copy that mixes two publishes fails the check.
+// Exits non-zero if any copy was torn, or if no read succeeded at all.
+
+namespace {
+
+using Exporter = mp::ShmWorldExporter<mp::WorldState::maxPlayers>;
+using Reader = mp::ShmWorldReader<mp::WorldState::maxPlayers>;
+
+// A few kB so that a copy spans many cache lines and is easy to tear.
+struct Block {
+  std::array<std::uint64_t, 512> words;
+};
+
+constexpr std::uint64_t kWordStride = 0x9E3779B97F4A7C15ull;
+
+void FillBlock(Block& block, const std::uint64_t publish) {
+  for (std::size_t i = 0; i < block.words.size(); ++i) {
+    block.words[i] = publish ^ (i * kWordStride);
+  }
+}
+
+[[nodiscard]]
+bool IsWholeBlock(const Block& block) {
+  const std::uint64_t publish = block.words[0];
+  for (std::size_t i = 0; i < block.words.size(); ++i) {
+    if (block.words[i] != (publish ^ (i * kWordStride))) return false;
+  }
+  return true;
+}
+
+void FillWorld(mp::WorldState& world, const std::uint64_t tick) {
+  const auto low = static_cast<std::uint32_t>(tick);
+  for (std::uint32_t i = 0; i < world.players.size(); ++i) {
+    mp::Player& player = world.players[i];
+    player.id = low + i;
+    player.teamId = ~low + i;
+    player.lastInputSequence = low * 3 + i;
+    player.transform.restTicks = low ^ i;
+  }
+  world.puck.transform.restTicks = low;
+  world.goals[0] = low;
+  world.goals[1] = ~low;
+}
+
+[[nodiscard]]
+bool IsWholeWorld(const Reader::Snapshot& snapshot) {
+  const auto low = static_cast<std::uint32_t>(snapshot.tick);
+  const auto& world = snapshot.world;
+  if (world.playerCount != mp::WorldState::maxPlayers) return false;
+  for (std::uint32_t i = 0; i < world.playerCount; ++i) {
+    const mp::Player& player = world.players[i];
+    if (player.id != low + i || player.teamId != ~low + i ||
+        player.lastInputSequence != low * 3 + i ||
+        player.transform.restTicks != (low ^ i)) {
+      return false;
+    }
+  }
+  return world.puck.transform.restTicks == low && world.goals[0] == low &&
+         world.goals[1] == ~low;
+}
+
+struct ReaderCounts {
+  std::uint64_t reads{0};
+  std::uint64_t retries{0};
+  std::uint64_t torn{0};
+};
+
+int Run(const std::chrono::seconds duration, const unsigned readerCount) {
+  const std::string name =
+      "/hockey2d-seqlock-stress-" + std::to_string(getpid());
+  mp::SeqLock<Block> seqlock;
+  Exporter exporter(name);
+  const Reader reader(name);
+
+  std::atomic<bool> bIsRunning = true;
+  std::thread writer([&] {
+    Block block{};
+    mp::WorldState world;
+    world.players.resize(mp::WorldState::maxPlayers);
+    for (std::uint64_t publish = 1; bIsRunning; ++publish) {
+      FillBlock(block, publish);
+      seqlock.Publish(block);
+      FillWorld(world, publish);
+      exporter.Publish(publish, world);
+    }
+  });
+
+  std::vector<ReaderCounts> counts(readerCount);
+  std::vector<std::thread> readers;
+  for (unsigned r = 0; r < readerCount; ++r) {
+    readers.emplace_back([&, r] {
+      ReaderCounts& count = counts[r];
+      Block block{};
+      Reader::Snapshot snapshot{};
+      while (bIsRunning) {
+        if (seqlock.TryRead(block)) {
+          count.reads++;
+          if (!IsWholeBlock(block)) count.torn++;
+        } else {
+          count.retries++;
+        }
+        if (reader.ReadLatest(snapshot)) {
+          count.reads++;
+          if (!IsWholeWorld(snapshot)) count.torn++;
+        }
+        // a slot a few generations back, likely being overwritten
+        const std::uint64_t generation = reader.Generation();
+        if (generation > mp::kShmWorldSlots &&
+            reader.ReadGeneration(generation - mp::kShmWorldSlots + 1,
+                                  snapshot)) {
+          count.reads++;
+          if (!IsWholeWorld(snapshot)) count.torn++;
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(duration);
+  bIsRunning = false;
+  writer.join();
+  ReaderCounts total;
+  for (unsigned r = 0; r < readerCount; ++r) {
+    readers[r].join();
+    total.reads += counts[r].reads;
+    total.retries += counts[r].retries;
+    total.torn += counts[r].torn;
+  }
+
+  std::cout << "reads: " << total.reads << ", retried: " << total.retries
+            << ", torn: " << total.torn << "\n";
+  return total.torn == 0 && total.reads > 0 ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const std::chrono::seconds duration(argc > 1 ? std::atoi(argv[1]) : 2);
+  const unsigned readerCount =
+      argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 3;
+  return Run(duration, readerCount);
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
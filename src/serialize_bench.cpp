@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "cereal/archives/binary.hpp"
+#include "cereal/archives/json.hpp"
+#include "cereal/archives/portable_binary.hpp"
+#include "cereal/archives/xml.hpp"
+#include "cereal/external/rapidjson/ostreamwrapper.h"
+#include "cereal/external/rapidjson/prettywriter.h"
+#include "game_data.hpp"
+#include "net_common.hpp"
+
+// Encode and decode cost, message size and allocations per message of
+// Player, Puck and WorldState for every cereal archive, next to a raw memcpy
+// layout and a quantized bit-packed one that the snapshot path could use.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// keeps the timed work observable to the optimizer
+volatile std::size_t gSink = 0;
+
+struct BenchOptions {
+  std::vector<std::size_t> worldSizes{2, 10, 100, 1000, 10000};
+  std::chrono::milliseconds budget{100};  // per codec, type and direction
+  std::uint64_t seed{1};
+  std::string outputPath;  // empty: stdout
+};
+
+std::vector<std::size_t> ParseSizeList(const std::string_view list) {
+  std::vector<std::size_t> sizes;
+  std::size_t begin = 0;
+  while (begin <= list.size()) {
+    const std::size_t end = std::min(list.find(',', begin), list.size());
+    const std::string item(list.substr(begin, end - begin));
+    if (!item.empty()) {
+      sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+    }
+    begin = end + 1;
+  }
+  if (sizes.empty()) {
+    throw std::runtime_error("Empty list: " + std::string(list));
+  }
+  return sizes;
+}
+
+BenchOptions ParseOptions(const int argc, char* argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    if (arg == "--players") {
+      options.worldSizes = ParseSizeList(value());
+    } else if (arg == "--ms") {
+      options.budget =
+          std::chrono::milliseconds(std::max(1, std::atoi(value())));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--out") {
+      options.outputPath = value();
+    } else {
+      throw std::runtime_error(
+          "Usage: serialize_bench [--players 2,10,100,1000,10000] [--ms n] "
+          "[--seed n] [--out file.json]");
+    }
+  }
+  return options;
+}
+
+// Any cereal archive pair, through a std::stringstream like SerializePacket
+// and HandlePacket. Text archives finish their document on destruction.
+template <typename OutputArchive, typename InputArchive>
+struct CerealCodec {
+  static constexpr bool bIsLossy = false;
+
+  template <typename T>
+  static std::string Encode(const T& value) {
+    std::stringstream ss;
+    {
+      OutputArchive ar(ss);
+      ar(value);
+    }
+    return ss.str();
+  }
+
+  template <typename T>
+  static T Decode(const std::string& bytes) {
+    std::stringstream ss(bytes);
+    T value;
+    {
+      InputArchive ar(ss);
+      ar(value);
+    }
+    return value;
+  }
+};
+
+// The objects' memory as is; WorldState gets a player count up front.
+struct RawCodec {
+  static constexpr bool bIsLossy = false;
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  static std::string Encode(const T& value) {
+    std::string bytes(sizeof(T), '\0');
+    std::memcpy(bytes.data(), &value, sizeof(T));
+    return bytes;
+  }
+
+  static std::string Encode(const mp::WorldState& world) {
+    const auto count = static_cast<std::uint32_t>(world.players.size());
+    std::string bytes(kWorldHeader + count * sizeof(mp::Player), '\0');
+    char* out = bytes.data();
+    std::memcpy(out, &count, sizeof(count));
+    std::memcpy(out + sizeof(count), &world.puck, sizeof(world.puck));
+    std::memcpy(out + sizeof(count) + sizeof(world.puck), world.goals,
+                sizeof(world.goals));
+    std::memcpy(out + kWorldHeader, world.players.data(),
+                count * sizeof(mp::Player));
+    return bytes;
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  static T Decode(const std::string& bytes) {
+    if (bytes.size() != sizeof(T)) throw std::runtime_error("Bad raw size");
+    T value;
+    std::memcpy(&value, bytes.data(), sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+    requires std::is_same_v<T, mp::WorldState>
+  static T Decode(const std::string& bytes) {
+    std::uint32_t count = 0;
+    if (bytes.size() < kWorldHeader) throw std::runtime_error("Bad raw size");
+    std::memcpy(&count, bytes.data(), sizeof(count));
+    if (bytes.size() != kWorldHeader + count * sizeof(mp::Player)) {
+      throw std::runtime_error("Bad raw size");
+    }
+    mp::WorldState world;
+    std::memcpy(&world.puck, bytes.data() + sizeof(count), sizeof(world.puck));
+    std::memcpy(world.goals, bytes.data() + sizeof(count) + sizeof(world.puck),
+                sizeof(world.goals));
+    world.players.resize(count);
+    std::memcpy(world.players.data(), bytes.data() + kWorldHeader,
+                count * sizeof(mp::Player));
+    return world;
+  }
+
+  static constexpr std::size_t kWorldHeader =
+      sizeof(std::uint32_t) + sizeof(mp::Puck) + sizeof(mp::WorldState::goals);
+};
+
+// Least significant bit first; whole words are stored in host order, which
+// matches on the little-endian machines the game runs on.
+class BitWriter {
+ public:
+  // `bits` is at most 32
+  void Write(const std::uint32_t value, const int bits) {
+    accumulator_ |= std::uint64_t{value} << used_;
+    used_ += bits;
+    if (used_ >= 32) {
+      const auto word = static_cast<std::uint32_t>(accumulator_);
+      bytes_.append(reinterpret_cast<const char*>(&word), sizeof(word));
+      accumulator_ >>= 32;
+      used_ -= 32;
+    }
+  }
+
+  std::string Finish() {
+    for (; used_ > 0; used_ -= 8) {
+      bytes_.push_back(static_cast<char>(accumulator_ & 0xFF));
+      accumulator_ >>= 8;
+    }
+    return std::move(bytes_);
+  }
+
+  void Reserve(const std::size_t bytes) { bytes_.reserve(bytes); }
+
+ private:
+  std::string bytes_;
+  std::uint64_t accumulator_{0};
+  int used_{0};
+};
+
+class BitReader {
+ public:
+  explicit BitReader(const std::string& bytes) : bytes_(bytes) {}
+
+  std::uint32_t Read(const int bits) {
+    while (used_ < bits) {
+      if (next_ >= bytes_.size()) throw std::runtime_error("Bits ran out");
+      const auto byte = static_cast<std::uint8_t>(bytes_[next_++]);
+      accumulator_ |= std::uint64_t{byte} << used_;
+      used_ += 8;
+    }
+    const auto value = static_cast<std::uint32_t>(
+        accumulator_ & ((std::uint64_t{1} << bits) - 1));
+    accumulator_ >>= bits;
+    used_ -= bits;
+    return value;
+  }
+
+ private:
+  const std::string& bytes_;
+  std::size_t next_{0};
+  std::uint64_t accumulator_{0};
+  int used_{0};
+};
+
+// Positions, velocities, radii and masses as 16 bit fixed point over the
+// ranges the game uses; ids, sequences and scores stay full width.
+struct BitPackedCodec {
+  static constexpr bool bIsLossy = true;
+
+  static std::string Encode(const mp::Player& player) {
+    BitWriter writer;
+    Write(writer, player);
+    return writer.Finish();
+  }
+
+  static std::string Encode(const mp::Puck& puck) {
+    BitWriter writer;
+    Write(writer, puck.transform);
+    return writer.Finish();
+  }
+
+  static std::string Encode(const mp::WorldState& world) {
+    BitWriter writer;
+    writer.Reserve(16 + world.players.size() * 24);
+    writer.Write(static_cast<std::uint32_t>(world.players.size()), 32);
+    Write(writer, world.puck.transform);
+    writer.Write(world.goals[0], 32);
+    writer.Write(world.goals[1], 32);
+    for (const mp::Player& player : world.players) Write(writer, player);
+    return writer.Finish();
+  }
+
+  template <typename T>
+  static T Decode(const std::string& bytes) {
+    BitReader reader(bytes);
+    T value;
+    if constexpr (std::is_same_v<T, mp::Player>) {
+      Read(reader, value);
+    } else if constexpr (std::is_same_v<T, mp::Puck>) {
+      Read(reader, value.transform);
+    } else {
+      const std::uint32_t count = reader.Read(32);
+      // a count the message cannot hold would only allocate, not decode
+      if (count > bytes.size()) throw std::runtime_error("Bad player count");
+      Read(reader, value.puck.transform);
+      value.goals[0] = reader.Read(32);
+      value.goals[1] = reader.Read(32);
+      value.players.resize(count);
+      for (mp::Player& player : value.players) Read(reader, player);
+    }
+    return value;
+  }
+
+ private:
+  static constexpr float kPositionRange = 1.0f;
+  static constexpr float kVelocityRange = 8.0f;
+  static constexpr float kShapeRange = 0.128f;  // radius and mass
+
+  static std::uint32_t Quantize(const mp::Real value, const float range) {
+    const float clamped = std::clamp(mp::ToFloat(value), -range, range);
+    return static_cast<std::uint32_t>((clamped + range) / (2 * range) *
+                                          65535.0f +
+                                      0.5f);
+  }
+
+  static float Dequantize(const std::uint32_t value, const float range) {
+    return static_cast<float>(value) / 65535.0f * (2 * range) - range;
+  }
+
+  static void Write(BitWriter& writer, const mp::MoveableObject& object) {
+    writer.Write(Quantize(object.pos.x, kPositionRange), 16);
+    writer.Write(Quantize(object.pos.y, kPositionRange), 16);
+    writer.Write(Quantize(object.velocity.x, kVelocityRange), 16);
+    writer.Write(Quantize(object.velocity.y, kVelocityRange), 16);
+    writer.Write(Quantize(object.radius, kShapeRange), 16);
+    writer.Write(Quantize(object.mass, kShapeRange), 16);
+  }
+
+  static void Read(BitReader& reader, mp::MoveableObject& object) {
+    object.pos.x = Dequantize(reader.Read(16), kPositionRange);
+    object.pos.y = Dequantize(reader.Read(16), kPositionRange);
+    object.velocity.x = Dequantize(reader.Read(16), kVelocityRange);
+    object.velocity.y = Dequantize(reader.Read(16), kVelocityRange);
+    object.radius = Dequantize(reader.Read(16), kShapeRange);
+    object.mass = Dequantize(reader.Read(16), kShapeRange);
+  }
+
+  static void Write(BitWriter& writer, const mp::Player& player) {
+    writer.Write(player.id, 32);
+    writer.Write(player.teamId & 1, 1);
+    writer.Write(player.lastInputSequence, 32);
+    Write(writer, player.transform);
+  }
+
+  static void Read(BitReader& reader, mp::Player& player) {
+    player.id = reader.Read(32);
+    player.teamId = reader.Read(1);
+    player.lastInputSequence = reader.Read(32);
+    Read(reader, player.transform);
+  }
+};
+
+struct BenchResult {
+  std::string type;
+  std::size_t players;
+  std::string codec;
+  bool bIsLossy;
+  std::size_t bytes;
+  double encodeNs;
+  double decodeNs;
+  double encodeAllocs;
+  double decodeAllocs;
+};
+
+struct Timing {
+  double ns;
+  double allocs;
+};
+
+// Runs `work` for about `budget` and returns the per-call cost.
+template <typename Work>
+Timing TimePerCall(const Work& work, const std::chrono::milliseconds budget) {
+  // one untimed call to size the batch
+  const auto probeStart = Clock::now();
+  work();
+  const auto probe = std::max<Clock::duration>(Clock::now() - probeStart,
+                                               std::chrono::nanoseconds(1));
+  const std::uint64_t calls = std::max<std::uint64_t>(
+      3, static_cast<std::uint64_t>(
+             std::chrono::duration<double>(budget) /
+             std::chrono::duration<double>(probe)));
+  const std::uint64_t allocationsBefore = mp::HeapAllocations();
+  const auto start = Clock::now();
+  for (std::uint64_t i = 0; i < calls; ++i) work();
+  const auto elapsed = Clock::now() - start;
+  const std::uint64_t allocations = mp::HeapAllocations() - allocationsBefore;
+  return {std::chrono::duration<double, std::nano>(elapsed).count() /
+              static_cast<double>(calls),
+          static_cast<double>(allocations) / static_cast<double>(calls)};
+}
+
+template <typename Codec, typename T>
+BenchResult Measure(const std::string_view codec, const std::string_view type,
+                    const std::size_t players, const T& value,
+                    const BenchOptions& options) {
+  const std::string encoded = Codec::Encode(value);
+  // re-encoding what was decoded must give the same bytes back
+  if (Codec::Encode(Codec::template Decode<T>(encoded)) != encoded) {
+    throw std::runtime_error(std::string(codec) + " does not round trip " +
+                             std::string(type));
+  }
+
+  const Timing encode = TimePerCall(
+      [&] { gSink = Codec::Encode(value).size(); }, options.budget);
+  const Timing decode = TimePerCall(
+      [&] {
+        const T decoded = Codec::template Decode<T>(encoded);
+        gSink = reinterpret_cast<std::uintptr_t>(&decoded);
+      },
+      options.budget);
+
+  return {std::string(type), players,      std::string(codec),
+          Codec::bIsLossy,   encoded.size(), encode.ns,
+          decode.ns,         encode.allocs,  decode.allocs};
+}
+
+template <typename T>
+void MeasureAllCodecs(std::vector<BenchResult>& results,
+                      const std::string_view type, const std::size_t players,
+                      const T& value, const BenchOptions& options) {
+  using PortableBinary = CerealCodec<cereal::PortableBinaryOutputArchive,
+                                     cereal::PortableBinaryInputArchive>;
+  using Binary =
+      CerealCodec<cereal::BinaryOutputArchive, cereal::BinaryInputArchive>;
+  using Json = CerealCodec<cereal::JSONOutputArchive, cereal::JSONInputArchive>;
+  using Xml = CerealCodec<cereal::XMLOutputArchive, cereal::XMLInputArchive>;
+
+  results.push_back(Measure<PortableBinary>("portable-binary", type, players,
+                                            value, options));
+  results.push_back(Measure<Binary>("binary", type, players, value, options));
+  results.push_back(Measure<Json>("json", type, players, value, options));
+  results.push_back(Measure<Xml>("xml", type, players, value, options));
+  results.push_back(Measure<RawCodec>("raw", type, players, value, options));
+  results.push_back(
+      Measure<BitPackedCodec>("bit-packed", type, players, value, options));
+}
+
+mp::MoveableObject RandomBody(std::mt19937& gen, mp::MoveableObject body) {
+  const mp::Vector2f leftRight = mp::ToFloat(mp::WorldState::leftRightLines);
+  const mp::Vector2f topBottom = mp::ToFloat(mp::WorldState::fieldBorders[1]);
+  std::uniform_real_distribution<float> x(leftRight.x, leftRight.y);
+  std::uniform_real_distribution<float> y(topBottom.x, topBottom.y);
+  std::uniform_real_distribution<float> velocity(-1.5f, 1.5f);
+  body.pos = {x(gen), y(gen)};
+  body.velocity = {velocity(gen), velocity(gen)};
+  return body;
+}
+
+mp::WorldState RandomWorld(std::mt19937& gen, const std::size_t players) {
+  mp::WorldState world;
+  world.puck.transform = RandomBody(gen, world.puck.transform);
+  world.goals[0] = 3;
+  world.goals[1] = 7;
+  for (std::size_t i = 0; i < players; ++i) {
+    mp::Player player{.id = static_cast<std::uint32_t>(i),
+                      .teamId = static_cast<std::uint32_t>(i % 2)};
+    player.transform = RandomBody(gen, player.transform);
+    player.lastInputSequence = static_cast<std::uint32_t>(gen());
+    world.players.push_back(player);
+  }
+  return world;
+}
+
+template <typename Writer>
+void WriteResults(Writer& writer, const BenchOptions& options,
+                  const std::vector<BenchResult>& results) {
+  const auto megabytesPerSecond = [](const std::size_t bytes, const double ns) {
+    return ns > 0 ? static_cast<double>(bytes) / ns * 1e3 : 0.0;
+  };
+  writer.StartObject();
+  writer.Key("seed");
+  writer.Uint64(options.seed);
+  writer.Key("budgetMs");
+  writer.Int64(options.budget.count());
+  writer.Key("results");
+  writer.StartArray();
+  for (const BenchResult& result : results) {
+    writer.StartObject();
+    writer.Key("type");
+    writer.String(result.type.c_str());
+    writer.Key("players");
+    writer.Uint64(result.players);
+    writer.Key("codec");
+    writer.String(result.codec.c_str());
+    writer.Key("lossy");
+    writer.Bool(result.bIsLossy);
+    writer.Key("bytes");
+    writer.Uint64(result.bytes);
+    writer.Key("encodeNs");
+    writer.Double(result.encodeNs);
+    writer.Key("decodeNs");
+    writer.Double(result.decodeNs);
+    writer.Key("encodeMBps");
+    writer.Double(megabytesPerSecond(result.bytes, result.encodeNs));
+    writer.Key("decodeMBps");
+    writer.Double(megabytesPerSecond(result.bytes, result.decodeNs));
+    writer.Key("encodeAllocs");
+    writer.Double(result.encodeAllocs);
+    writer.Key("decodeAllocs");
+    writer.Double(result.decodeAllocs);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const BenchOptions options = ParseOptions(argc, argv);
+  std::mt19937 gen(static_cast<std::mt19937::result_type>(options.seed));
+
+  std::vector<BenchResult> results;
+  mp::Player player{.id = 7, .teamId = 1, .lastInputSequence = 1234};
+  player.transform = RandomBody(gen, player.transform);
+  MeasureAllCodecs(results, "Player", 1, player, options);
+  mp::Puck puck;
+  puck.transform = RandomBody(gen, puck.transform);
+  MeasureAllCodecs(results, "Puck", 0, puck, options);
+  for (const std::size_t players : options.worldSizes) {
+    MeasureAllCodecs(results, "WorldState", players, RandomWorld(gen, players),
+                     options);
+  }
+
+  std::cerr << std::setw(12) << std::left << "type" << std::setw(8)
+            << "players" << std::setw(17) << "codec" << std::right
+            << std::setw(10) << "bytes" << std::setw(14) << "encode ns"
+            << std::setw(14) << "decode ns" << std::setw(12) << "enc allocs"
+            << std::setw(12) << "dec allocs" << "\n";
+  for (const BenchResult& result : results) {
+    std::cerr << std::setw(12) << std::left << result.type << std::setw(8)
+              << result.players << std::setw(17) << result.codec << std::right
+              << std::fixed << std::setprecision(1) << std::setw(10)
+              << result.bytes << std::setw(14) << result.encodeNs
+              << std::setw(14) << result.decodeNs << std::setw(12)
+              << result.encodeAllocs << std::setw(12) << result.decodeAllocs
+              << "\n"
+              << std::defaultfloat;
+  }
+
+  std::ofstream file;
+  if (!options.outputPath.empty()) {
+    file.open(options.outputPath);
+    if (!file) throw std::runtime_error("Failed to open " + options.outputPath);
+  }
+  std::ostream& out = options.outputPath.empty() ? std::cout : file;
+  rapidjson::OStreamWrapper stream(out);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  WriteResults(writer, options, results);
+  out << "\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "game_data.hpp"
+#include "lag_compensation.hpp"
+#include "mpr_utility.hpp"
+#include "net_common.hpp"
+#include "resting_snapshot.hpp"
+#include "simulation.hpp"
+#include "world_hash.hpp"
+#include "world_history.hpp"
+
+namespace mp {
+
+// Platform independent part of the server: owns the world, reacts to transport
+// events and advances the simulation. The platform mains decide when to call
+// Service and Tick.
+class GameServer final {
+ public:
+  GameServer(const GameServer& other) = delete;
+  GameServer& operator=(const GameServer& other) = delete;
+
+  // `seed` keys the room's spawns, see SpawnArea. The room keeps the worlds
+  // of its ticks, `tickPeriod` apart, for the last `historyDepth`.
+  explicit GameServer(
+      const std::uint64_t seed,
+      const std::chrono::microseconds tickPeriod = std::chrono::microseconds{
+          10'000},
+      const std::chrono::milliseconds historyDepth = kWorldHistoryDepth)
+      : spawnArea_(seed),
+        history_(historyDepth, tickPeriod),
+        lagCompensator_(kMaxLagCompensation, tickPeriod) {
+    packetHandler_.RegisterHandler<mp::Player>(
+        mp::PacketType::PlayerInputUpdate,
+        [this](const mp::Player& data) { ApplyInput(data); });
+    packetHandler_.RegisterHandler<mp::TaggedInput>(
+        mp::PacketType::TaggedInputUpdate, [this](const mp::TaggedInput& data) {
+          mp::Player* player = ApplyInput(data.player);
+          if (player && lagCompensator_.CompensateHit(
+                            player->transform, worldState_.puck.transform,
+                            data.renderTick)) {
+            compensatedHits_++;
+          }
+        });
+    packetHandler_.RegisterHandler<std::uint32_t>(
+        mp::PacketType::Disconnect,
+        [this](const std::uint32_t& id) { Leave(id); });
+  }
+
+  // Receive input from players
+  void Service(Transport& transport) {
+    TransportEvent event;
+    while (transport.Poll(event)) {
+      switch (event.type) {
+        case TransportEventType::Connect: {
+          std::cout << "OnConnect\n";
+          mp::SendPacket(transport, event.peer, mp::PacketType::Connect,
+                         Join());
+        } break;
+        case TransportEventType::Disconnect:
+          break;
+        case TransportEventType::Receive:
+          Receive(event.data.data(), event.data.size());
+          break;
+      }
+    }
+  }
+
+  // Adds a player for a freshly connected peer; the caller replies with it
+  // in a Connect packet.
+  mp::Player Join() {
+    mp::Player newPlayer{
+        .id = currentPlayerId_,
+        .teamId = currentPlayerId_ % 2,
+    };
+    // Find appropriate pos for new player
+    spawnArea_.ResetPlayerPos(newPlayer, worldState_.players, currentTick_);
+    currentPlayerId_++;
+    worldState_.players.push_back(newPlayer);
+    // the newcomer needs every body once
+    lastSnapshotTick_.reset();
+    return newPlayer;
+  }
+
+  // Drops the player of a peer that said goodbye or went away without it;
+  // ids not in the room, e.g. from a repeated goodbye, are ignored.
+  void Leave(const std::uint32_t id) {
+    const auto it = mp::FindRequiredPlayer(worldState_.players.begin(),
+                                           worldState_.players.end(), id);
+    if (it == worldState_.players.end()) return;
+    *it = worldState_.players.back();
+    worldState_.players.pop_back();
+  }
+
+  void Receive(const std::uint8_t* data, const std::size_t size) {
+    mp::HandlePacket(data, size, packetHandler_);
+  }
+
+  void Tick() {
+    currentTick_++;
+    StepWorld(worldState_, spawnArea_, currentTick_, contactSolver_);
+    history_.Record(currentTick_, worldState_);
+    lagCompensator_.Record(currentTick_, worldState_.puck.transform.pos);
+  }
+
+  // replicate world state
+  void BroadcastWorld(Transport& transport) {
+    const std::string packet = SerializeWorld();
+    transport.Broadcast(AsBytes(packet), 0, kPacketReliable);
+  }
+
+  // Snapshot packet for callers that fan it out to peers themselves, sent
+  // reliably to every member of the room. Bodies asleep since the previous
+  // snapshot are left out of it.
+  [[nodiscard]]
+  std::string SerializeWorld() {
+    const std::optional<std::uint64_t> lastTick =
+        std::exchange(lastSnapshotTick_, currentTick_);
+    if (bHashesSnapshots_) {
+      return SerializeHashedWorld(currentTick_, worldState_);
+    }
+    if (!lastTick) {
+      return mp::SerializePacket(mp::PacketType::WorldState,
+                                 TickedWorldState{currentTick_, worldState_});
+    }
+    return SerializeRestingWorld(currentTick_, worldState_,
+                                 kSleepTicks + (currentTick_ - *lastTick));
+  }
+
+  // Snapshots go out as HashedWorldState, so that clients can check their
+  // own simulation against the server's tick by tick.
+  void SetSnapshotHashes(const bool bIsEnabled) {
+    bHashesSnapshots_ = bIsEnabled;
+  }
+
+  [[nodiscard]]
+  const WorldState& World() const {
+    return worldState_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t CurrentTick() const {
+    return currentTick_;
+  }
+
+  // Puck hits that counted only because of lag compensation.
+  [[nodiscard]]
+  std::uint64_t CompensatedHits() const {
+    return compensatedHits_;
+  }
+
+  // Worlds of the recent ticks, the current one included.
+  [[nodiscard]]
+  const WorldHistory& History() const {
+    return history_;
+  }
+
+ private:
+  // The player the input moved; null, dropping the input, when there is no
+  // such player, e.g. one that left while the input was on its way.
+  mp::Player* ApplyInput(const mp::Player& data) {
+    const auto it = mp::FindRequiredPlayer(worldState_.players.begin(),
+                                           worldState_.players.end(), data.id);
+    if (it == worldState_.players.end()) return nullptr;
+    it->transform.velocity = data.transform.velocity;
+    it->transform.restTicks = 0;
+    it->lastInputSequence =
+        std::max(it->lastInputSequence, data.lastInputSequence);
+    return &*it;
+  }
+
+  WorldState worldState_;
+  PacketHandler packetHandler_;
+  SpawnArea spawnArea_;
+  ContactSolver contactSolver_;  // serial, a room is too small to split
+  WorldHistory history_;
+  LagCompensator lagCompensator_;
+  std::uint64_t compensatedHits_{0};
+  std::uint32_t currentPlayerId_{0};
+  std::uint64_t currentTick_{0};
+  bool bHashesSnapshots_{false};
+  // tick of the last snapshot everyone in the room has, if any
+  std::optional<std::uint64_t> lastSnapshotTick_;
+};
+
+}  // namespace mp
@@ -0,0 +1,177 @@
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "server_worker.hpp"
+
+namespace {
+
+std::string GetLocalIPv4Address() {
+  ifaddrs* interfaces = nullptr;
+  if (getifaddrs(&interfaces) != 0) {
+    return {};
+  }
+
+  std::string localIP;
+  for (const ifaddrs* it = interfaces; it != nullptr; it = it->ifa_next) {
+    if (!it->ifa_addr || it->ifa_addr->sa_family != AF_INET) continue;
+    if (!(it->ifa_flags & IFF_UP) || (it->ifa_flags & IFF_LOOPBACK)) continue;
+
+    const auto* sa_in = reinterpret_cast<const sockaddr_in*>(it->ifa_addr);
+    const std::uint32_t ip = ntohl(sa_in->sin_addr.s_addr);
+    if ((ip >> 24) == 127 || (ip >> 16) == 0xA9FE) continue;
+
+    char ipStr[INET_ADDRSTRLEN];
+    if (inet_ntop(AF_INET, &sa_in->sin_addr, ipStr, sizeof(ipStr))) {
+      localIP = ipStr;
+      break;
+    }
+  }
+
+  freeifaddrs(interfaces);
+  return localIP;
+}
+
+struct ServerOptions {
+  std::string bindAddress;  // empty: first non-loopback interface
+  std::uint16_t port{5000};
+  std::chrono::microseconds tickPeriod{10'000};
+  std::chrono::milliseconds historyDepth{mp::kWorldHistoryDepth};
+  // every worker owns one socket on the shared port and a share of the rooms
+  std::size_t workerCount{1};
+  std::size_t roomCount{0};  // 0: one per worker
+  std::uint64_t seed{std::random_device{}()};
+  bool bExportShm{false};
+  bool bUseBatchedIo{false};
+  bool bHashSnapshots{false};
+  mp::RealtimeOptions realtime;
+  std::optional<mp::ImpairmentConfig> impairment;
+};
+
+ServerOptions ParseOptions(const int argc, char* argv[]) {
+  ServerOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    const auto impairment = [&]() -> mp::ImpairmentConfig& {
+      return options.impairment ? *options.impairment
+                                : options.impairment.emplace();
+    };
+    if (arg == "--bind") {
+      options.bindAddress = value();
+    } else if (arg == "--port") {
+      options.port = static_cast<std::uint16_t>(std::atoi(value()));
+    } else if (arg == "--tick-us") {
+      options.tickPeriod = std::chrono::microseconds(std::atoll(value()));
+    } else if (arg == "--history-ms") {
+      options.historyDepth = std::chrono::milliseconds(std::atoll(value()));
+    } else if (arg == "--workers") {
+      options.workerCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--rooms") {
+      options.roomCount = std::max(1, std::atoi(value()));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--shm") {
+      options.bExportShm = true;
+    } else if (arg == "--batched-io") {
+      options.bUseBatchedIo = true;
+    } else if (arg == "--hash-snapshots") {
+      options.bHashSnapshots = true;
+    } else if (arg == "--rt") {
+      options.realtime.bIsEnabled = true;
+    } else if (arg == "--rt-cpus") {
+      options.realtime.bIsEnabled = true;
+      options.realtime.cpus = mp::ParseCpuList(value());
+    } else if (arg == "--rt-fifo") {
+      options.realtime.bIsEnabled = true;
+      options.realtime.fifoPriority = std::atoi(value());
+    } else if (arg == "--rt-spin-us") {
+      options.realtime.bIsEnabled = true;
+      options.realtime.spinLead = std::chrono::microseconds(std::atoi(value()));
+    } else if (arg == "--impair-out") {
+      impairment().outbound = mp::ParseImpairmentProfile(value());
+    } else if (arg == "--impair-in") {
+      impairment().inbound = mp::ParseImpairmentProfile(value());
+    } else if (arg == "--impair-seed") {
+      impairment().seed = std::strtoull(value(), nullptr, 10);
+    } else {
+      throw std::runtime_error(
+          "Usage: server [--bind ip] [--port port] [--tick-us period] "
+          "[--history-ms depth] [--workers count] [--rooms count] "
+          "[--seed n] [--shm] [--batched-io] [--hash-snapshots] [--rt] "
+          "[--rt-cpus 2,3] [--rt-fifo priority] [--rt-spin-us lead] "
+          "[--impair-out spec] [--impair-in spec] [--impair-seed seed]");
+    }
+  }
+  return options;
+}
+
+mp::ServerWorkerGroup* signalWorkers = nullptr;
+
+void OnStopSignal(int) {
+  if (signalWorkers) signalWorkers->Broadcast(mp::kControlStop);
+}
+
+void OnStatsSignal(int) {
+  if (signalWorkers) signalWorkers->Broadcast(mp::kControlPrintStats);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const ServerOptions options = ParseOptions(argc, argv);
+
+  if (options.bUseBatchedIo && !mp::kHasBatchedEnetIo) {
+    throw std::runtime_error("This build has no batched UDP I/O support");
+  }
+  mp::EnableBatchedEnetIo(options.bUseBatchedIo);
+
+  mp::EnetInit();
+  assert(0 == atexit(enet_deinitialize));
+
+  const std::string bindIp = options.bindAddress.empty()
+                                 ? GetLocalIPv4Address()
+                                 : options.bindAddress;
+
+  mp::ServerWorkerGroup workers({
+      .address = mp::EnetCreateAddress(options.port, bindIp.c_str()),
+      .workerCount = options.workerCount,
+      .roomCount = options.roomCount ? options.roomCount : options.workerCount,
+      .tickPeriod = options.tickPeriod,
+      .historyDepth = options.historyDepth,
+      .seed = options.seed,
+      .realtime = options.realtime,
+      .bExportShm = options.bExportShm,
+      .bHashSnapshots = options.bHashSnapshots,
+      .impairment = options.impairment,
+  });
+  signalWorkers = &workers;
+  std::signal(SIGINT, OnStopSignal);
+  std::signal(SIGTERM, OnStopSignal);
+  std::signal(SIGUSR1, OnStatsSignal);
+
+  std::cout << "Server is running, ip: " << bindIp << ", port: " << options.port
+            << ", workers: " << options.workerCount << "\n";
+  workers.Run();
+
+  signalWorkers = nullptr;
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,572 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "counter_rng.hpp"
+#include "enet_transport.hpp"
+#include "float_env.hpp"
+#include "impaired_transport.hpp"
+#include "linux_loop.hpp"
+#include "realtime_tick.hpp"
+#include "server_core.hpp"
+#include "shm_world.hpp"
+#include "world_publisher.hpp"
+
+namespace mp {
+
+// Creates an ENet host whose socket shares `address` with the other hosts of
+// the process; the kernel spreads incoming flows between them by 4-tuple.
+inline EnetHostPtr EnetCreateReusePortHost(const ENetAddress& address,
+                                           const std::size_t numConnections,
+                                           const std::size_t numChannels) {
+  // no address: ENet leaves the socket unbound, so the option can be set
+  auto host = EnetCreateHost(nullptr, numConnections, numChannels);
+  if (!host) {
+    throw std::runtime_error("Failed to create host");
+  }
+  const int enable = 1;
+  if (setsockopt(host->socket, SOL_SOCKET, SO_REUSEPORT, &enable,
+                 sizeof(enable)) != 0 ||
+      enet_socket_bind(host->socket, &address) != 0) {
+    throw std::runtime_error("Failed to bind a shared port");
+  }
+  if (enet_socket_get_address(host->socket, &host->address) != 0) {
+    host->address = address;
+  }
+  return host;
+}
+
+struct WorkerConfig {
+  ENetAddress address{};
+  std::size_t workerCount{1};
+  std::size_t roomCount{1};
+  std::chrono::microseconds tickPeriod{10'000};
+  std::chrono::milliseconds historyDepth{kWorldHistoryDepth};
+  std::uint64_t seed{0};  // keys every room's spawns, see RoomSeed
+  RealtimeOptions realtime;
+  bool bExportShm{false};
+  bool bHashSnapshots{false};
+  std::optional<ImpairmentConfig> impairment;
+};
+
+// Which worker runs a room and how many seats are taken in it. Shared by all
+// workers, touched only on connect and disconnect.
+class RoomDirectory final {
+ public:
+  RoomDirectory(const std::size_t roomCount, const std::size_t workerCount)
+      : seats_(roomCount, 0), workerCount_(workerCount) {}
+
+  [[nodiscard]]
+  std::size_t OwnerOf(const std::uint32_t roomId) const {
+    return roomId % workerCount_;
+  }
+
+  // Prefers a room run by `worker` so that the connection needs no handoff.
+  std::optional<std::uint32_t> Reserve(const std::size_t worker) {
+    const std::lock_guard lock(mutex_);
+    std::optional<std::uint32_t> fallback;
+    for (std::uint32_t roomId = 0; roomId < seats_.size(); ++roomId) {
+      if (seats_[roomId] >= WorldState::maxPlayers) continue;
+      if (OwnerOf(roomId) == worker) {
+        seats_[roomId]++;
+        return roomId;
+      }
+      if (!fallback) fallback = roomId;
+    }
+    if (fallback) seats_[*fallback]++;
+    return fallback;
+  }
+
+  void Release(const std::uint32_t roomId) {
+    const std::lock_guard lock(mutex_);
+    seats_[roomId]--;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::size_t> seats_;
+  std::size_t workerCount_;
+};
+
+// Cross-worker traffic for peers whose socket lives on one worker (the
+// proxy) while their room runs on another (the owner).
+struct WorkerMessage {
+  enum class Type : std::uint8_t {
+    Join,      // proxy -> owner: seat a new player
+    Input,     // proxy -> owner: packet received from the peer
+    Leave,     // proxy -> owner: the peer is gone
+    Outbound,  // owner -> proxy: packet to send to the peer
+  };
+
+  Type type;
+  std::size_t fromWorker{0};
+  std::uint32_t roomId{0};
+  std::uint64_t proxyId{0};
+  std::uint32_t packetFlags{0};
+  std::vector<std::uint8_t> bytes;
+};
+
+// What a worker put on and took off the wire, as the server sees it.
+struct WorkerTraffic {
+  std::uint64_t connects{0};
+  std::uint64_t disconnects{0};
+  std::uint64_t snapshots{0};
+  std::uint64_t bytesSent{0};
+  std::uint64_t bytesReceived{0};
+  // packets a room could not parse, dropped
+  std::uint64_t malformed{0};
+};
+
+class ServerWorkerGroup;
+
+// One ENet transport on the shared port plus the rooms it simulates, driven by
+// its own epoll loop on its own thread.
+class ServerWorker final {
+ public:
+  ServerWorker(const ServerWorker& other) = delete;
+  ServerWorker& operator=(const ServerWorker& other) = delete;
+
+  ServerWorker(std::size_t index, const WorkerConfig& config,
+               ServerWorkerGroup& group);
+
+  void Run();
+
+  // Thread and async-signal safe.
+  void Post(const std::uint32_t controlMessages) {
+    control_.Post(controlMessages);
+  }
+
+  // Thread safe.
+  void Post(WorkerMessage message) {
+    {
+      const std::lock_guard lock(mailboxMutex_);
+      mailbox_.push_back(std::move(message));
+    }
+    control_.Post(kControlMailbox);
+  }
+
+ private:
+  struct Member {
+    std::uint32_t playerId;
+    PeerId peer;  // kInvalidPeerId when the peer is owned by another worker
+    std::size_t proxyWorker;
+    std::uint64_t proxyId;
+  };
+
+  struct Room {
+    Room(const std::uint64_t seed, const WorkerConfig& config)
+        : server(seed, config.tickPeriod, config.historyDepth) {}
+
+    GameServer server;
+    std::vector<Member> members;
+    WorldPublisher<WorldState::maxPlayers> publisher;
+    std::optional<ShmWorldExporter<WorldState::maxPlayers>> shmExporter;
+  };
+
+  struct LocalPeer {
+    std::uint32_t roomId;
+    std::size_t owner;
+    std::uint64_t proxyId;
+    std::uint32_t playerId;
+  };
+
+  void ServiceHost();
+  void OnConnect(PeerId peer);
+  void OnDisconnect(PeerId peer);
+  void OnTick();
+  void OnRelease();
+  void ArmReleaseTimer();
+  void OnControl();
+  void DrainMailbox();
+  bool Deliver(Room& room, std::span<const std::uint8_t> bytes);
+
+  void PrintStats();
+  void SeatPlayer(std::uint32_t roomId, Member member);
+  void SendToMember(const Member& member, std::span<const std::uint8_t> bytes,
+                    std::uint32_t flags);
+
+  std::size_t index_;
+  const WorkerConfig& config_;
+  ServerWorkerGroup& group_;
+
+  EnetTransport enetTransport_;
+  std::optional<ImpairedTransport> impairedTransport_;
+  Transport& transport_;
+  EpollLoop loop_;
+  TickTimer tickTimer_;
+  // due times of the packets held back by an impaired transport
+  std::optional<DeadlineTimer> releaseTimer_;
+  ControlChannel control_;
+  LatenessHistogram tickLateness_;
+  WorkerTraffic traffic_;
+  WorkerTraffic printedTraffic_;
+  std::chrono::steady_clock::time_point printedAt_{
+      std::chrono::steady_clock::now()};
+  bool bIsRunning_{true};
+
+  std::unordered_map<std::uint32_t, std::unique_ptr<Room>> rooms_;
+  std::unordered_map<PeerId, LocalPeer> peers_;
+  // peers connected here whose room runs elsewhere
+  std::unordered_map<std::uint64_t, PeerId> proxies_;
+  std::uint64_t nextProxyId_{0};
+
+  std::mutex mailboxMutex_;
+  std::vector<WorkerMessage> mailbox_;
+};
+
+class ServerWorkerGroup final {
+ public:
+  explicit ServerWorkerGroup(WorkerConfig config)
+      : config_(std::move(config)),
+        directory_(config_.roomCount, config_.workerCount) {
+    for (std::size_t i = 0; i < config_.workerCount; ++i) {
+      workers_.push_back(std::make_unique<ServerWorker>(i, config_, *this));
+    }
+  }
+
+  // Worker 0 runs on the calling thread; returns once every worker stopped.
+  // A worker that throws stops the others, and Run rethrows its exception.
+  void Run() {
+    std::vector<std::exception_ptr> failures(workers_.size());
+    {
+      const auto run = [this, &failures](const std::size_t i) {
+        try {
+          workers_[i]->Run();
+        } catch (...) {
+          failures[i] = std::current_exception();
+          // the others only stop when told to
+          Broadcast(kControlStop);
+        }
+      };
+      std::vector<std::jthread> threads;
+      for (std::size_t i = 1; i < workers_.size(); ++i) {
+        threads.emplace_back(run, i);
+      }
+      run(0);
+    }
+    for (const std::exception_ptr& failure : failures) {
+      if (failure) std::rethrow_exception(failure);
+    }
+  }
+
+  // Async-signal safe.
+  void Broadcast(const std::uint32_t controlMessages) {
+    for (const auto& worker : workers_) {
+      worker->Post(controlMessages);
+    }
+  }
+
+  void Post(const std::size_t worker, WorkerMessage message) {
+    workers_[worker]->Post(std::move(message));
+  }
+
+  RoomDirectory& Directory() { return directory_; }
+
+ private:
+  WorkerConfig config_;
+  RoomDirectory directory_;
+  std::vector<std::unique_ptr<ServerWorker>> workers_;
+};
+
+inline ServerWorker::ServerWorker(const std::size_t index,
+                                  const WorkerConfig& config,
+                                  ServerWorkerGroup& group)
+    : index_(index),
+      config_(config),
+      group_(group),
+      enetTransport_(EnetCreateReusePortHost(
+          config.address, config.roomCount * WorldState::maxPlayers, 2)),
+      transport_(config.impairment
+                     ? impairedTransport_.emplace(enetTransport_,
+                                                  *config.impairment)
+                     : static_cast<Transport&>(enetTransport_)),
+      tickTimer_(config.tickPeriod, config.realtime.bIsEnabled
+                                        ? config.realtime.spinLead
+                                        : std::chrono::microseconds{}) {
+  for (std::uint32_t roomId = 0; roomId < config.roomCount; ++roomId) {
+    if (group_.Directory().OwnerOf(roomId) != index_) continue;
+    auto room = std::make_unique<Room>(RoomSeed(config.seed, roomId), config);
+    if (config.bExportShm) room->shmExporter.emplace(ShmWorldName(roomId));
+    room->server.SetSnapshotHashes(config.bHashSnapshots);
+    rooms_.emplace(roomId, std::move(room));
+  }
+
+  loop_.Watch(enetTransport_.NativeHandle(), [this] { ServiceHost(); });
+  loop_.Watch(tickTimer_.Fd(), [this] { OnTick(); });
+  if (impairedTransport_) {
+    releaseTimer_.emplace();
+    loop_.Watch(releaseTimer_->Fd(), [this] { OnRelease(); });
+  }
+  loop_.Watch(control_.Fd(), [this] { OnControl(); });
+}
+
+inline void ServerWorker::Run() {
+  SetDenormalFlush(true);
+  ApplyRealtimeOptions(config_.realtime, index_);
+  while (bIsRunning_) {
+    loop_.Wait();
+    ArmReleaseTimer();
+  }
+  std::cout << "Worker " << index_ << " stopped\n";
+  PrintStats();
+}
+
+inline void ServerWorker::PrintStats() {
+  const auto now = std::chrono::steady_clock::now();
+  const double seconds =
+      std::max(std::chrono::duration<double>(now - printedAt_).count(), 1e-9);
+  const auto rate = [seconds](const std::uint64_t count) {
+    return static_cast<std::uint64_t>(static_cast<double>(count) / seconds);
+  };
+  const std::string name = "Worker " + std::to_string(index_);
+  tickLateness_.Print(std::cout, name + " tick lateness");
+  std::cout << name << " traffic: " << peers_.size() << " peers, "
+            << traffic_.connects << " connects, " << traffic_.disconnects
+            << " disconnects, snapshots/s "
+            << rate(traffic_.snapshots - printedTraffic_.snapshots)
+            << ", tx B/s "
+            << rate(traffic_.bytesSent - printedTraffic_.bytesSent)
+            << ", rx B/s "
+            << rate(traffic_.bytesReceived - printedTraffic_.bytesReceived)
+            << ", " << traffic_.malformed << " malformed\n";
+  printedTraffic_ = traffic_;
+  printedAt_ = now;
+}
+
+inline void ServerWorker::ServiceHost() {
+  TransportEvent event;
+  while (transport_.Poll(event)) {
+    switch (event.type) {
+      case TransportEventType::Connect:
+        traffic_.connects++;
+        OnConnect(event.peer);
+        break;
+      case TransportEventType::Disconnect:
+        traffic_.disconnects++;
+        OnDisconnect(event.peer);
+        break;
+      case TransportEventType::Receive: {
+        traffic_.bytesReceived += event.data.size();
+        if (const auto it = peers_.find(event.peer); it != peers_.end()) {
+          const LocalPeer& local = it->second;
+          if (local.owner == index_) {
+            if (!Deliver(*rooms_.at(local.roomId), event.data)) {
+              transport_.Disconnect(event.peer);
+            }
+          } else {
+            group_.Post(local.owner,
+                        {.type = WorkerMessage::Type::Input,
+                         .fromWorker = index_,
+                         .roomId = local.roomId,
+                         .proxyId = local.proxyId,
+                         .bytes = {event.data.begin(), event.data.end()}});
+          }
+        }
+      } break;
+    }
+  }
+}
+
+inline void ServerWorker::OnConnect(const PeerId peer) {
+  const std::optional<std::uint32_t> roomId =
+      group_.Directory().Reserve(index_);
+  if (!roomId) {
+    std::cout << "Server is full, dropping connection\n";
+    transport_.Disconnect(peer);
+    return;
+  }
+
+  const std::size_t owner = group_.Directory().OwnerOf(*roomId);
+  const std::uint64_t proxyId = nextProxyId_++;
+  peers_[peer] = {
+      .roomId = *roomId, .owner = owner, .proxyId = proxyId, .playerId = ~0u};
+  if (owner == index_) {
+    SeatPlayer(*roomId, {.peer = peer, .proxyWorker = index_});
+  } else {
+    // hand the peer off: its socket stays here, the room runs on `owner`
+    proxies_[proxyId] = peer;
+    group_.Post(owner, {.type = WorkerMessage::Type::Join,
+                        .fromWorker = index_,
+                        .roomId = *roomId,
+                        .proxyId = proxyId});
+  }
+}
+
+inline void ServerWorker::OnDisconnect(const PeerId peer) {
+  const auto it = peers_.find(peer);
+  if (it == peers_.end()) return;
+  const LocalPeer local = it->second;
+  peers_.erase(it);
+  group_.Directory().Release(local.roomId);
+
+  if (local.owner == index_) {
+    Room& room = *rooms_.at(local.roomId);
+    std::erase_if(room.members,
+                  [peer](const Member& m) { return m.peer == peer; });
+    room.server.Leave(local.playerId);
+  } else {
+    proxies_.erase(local.proxyId);
+    group_.Post(local.owner, {.type = WorkerMessage::Type::Leave,
+                              .fromWorker = index_,
+                              .roomId = local.roomId,
+                              .proxyId = local.proxyId});
+  }
+}
+
+inline void ServerWorker::SeatPlayer(const std::uint32_t roomId,
+                                     Member member) {
+  Room& room = *rooms_.at(roomId);
+  const Player player = room.server.Join();
+  member.playerId = player.id;
+  if (member.peer != kInvalidPeerId) {
+    peers_.at(member.peer).playerId = player.id;
+  }
+  room.members.push_back(member);
+
+  const std::string packet =
+      SerializePacket(PacketType::Connect, Player{player});
+  SendToMember(member, AsBytes(packet), kPacketReliable);
+}
+
+inline void ServerWorker::SendToMember(
+    const Member& member, const std::span<const std::uint8_t> bytes,
+    const std::uint32_t flags) {
+  if (member.peer != kInvalidPeerId) {
+    transport_.Send(member.peer, bytes, 0, flags);
+    return;
+  }
+  group_.Post(member.proxyWorker, {.type = WorkerMessage::Type::Outbound,
+                                   .fromWorker = index_,
+                                   .proxyId = member.proxyId,
+                                   .packetFlags = flags,
+                                   .bytes = {bytes.begin(), bytes.end()}});
+}
+
+inline void ServerWorker::OnTick() {
+  // ticks to run at most when the loop wakes up late, instead of spiralling
+  constexpr std::uint64_t kMaxCatchUpTicks = 5;
+
+  const std::uint64_t ticks =
+      std::min(tickTimer_.Expirations(), kMaxCatchUpTicks);
+  if (ticks == 0) return;
+  if (config_.realtime.bIsEnabled) SpinUntil(tickTimer_.Deadline());
+  tickLateness_.Record(std::chrono::steady_clock::now() -
+                       tickTimer_.Deadline());
+
+  // also runs ENet timeouts and resends when no packets are arriving
+  ServiceHost();
+  for (auto& [roomId, room] : rooms_) {
+    for (std::uint64_t i = 0; i < ticks; ++i) {
+      room->server.Tick();
+    }
+    // replicate world state
+    const std::string packet = room->server.SerializeWorld();
+    for (const Member& member : room->members) {
+      SendToMember(member, AsBytes(packet), kPacketReliable);
+    }
+    traffic_.snapshots += room->members.size();
+    traffic_.bytesSent += packet.size() * room->members.size();
+
+    room->publisher.Publish(room->server.CurrentTick(), room->server.World());
+    if (room->shmExporter) {
+      room->shmExporter->Publish(room->server.CurrentTick(),
+                                 room->server.World());
+    }
+  }
+  transport_.Flush();
+}
+
+// Held back packets leave when they are due, not on the next tick or
+// arrival.
+inline void ServerWorker::OnRelease() {
+  releaseTimer_->Acknowledge();
+  ServiceHost();
+  transport_.Flush();
+}
+
+inline void ServerWorker::ArmReleaseTimer() {
+  if (!releaseTimer_) return;
+  if (const auto next = impairedTransport_->NextRelease()) {
+    releaseTimer_->Arm(*next);
+  } else {
+    releaseTimer_->Disarm();
+  }
+}
+
+inline void ServerWorker::OnControl() {
+  const std::uint32_t messages = control_.Drain();
+  if (messages & kControlMailbox) DrainMailbox();
+  if (messages & kControlPrintStats) PrintStats();
+  if (messages & kControlStop) bIsRunning_ = false;
+}
+
+// Hands a client's packet to its room; false, dropping it, when the packet
+// is malformed or of a type rooms do not take. Anyone can send one, so it
+// must not take the worker down.
+inline bool ServerWorker::Deliver(Room& room,
+                                  const std::span<const std::uint8_t> bytes) {
+  try {
+    room.server.Receive(bytes.data(), bytes.size());
+    return true;
+  } catch (const std::exception&) {
+    traffic_.malformed++;
+    return false;
+  }
+}
+
+inline void ServerWorker::DrainMailbox() {
+  std::vector<WorkerMessage> messages;
+  {
+    const std::lock_guard lock(mailboxMutex_);
+    messages.swap(mailbox_);
+  }
+
+  for (WorkerMessage& message : messages) {
+    switch (message.type) {
+      case WorkerMessage::Type::Join:
+        SeatPlayer(message.roomId, {.peer = kInvalidPeerId,
+                                    .proxyWorker = message.fromWorker,
+                                    .proxyId = message.proxyId});
+        break;
+      case WorkerMessage::Type::Input:
+        // the worker with the peer already let it go on
+        static_cast<void>(Deliver(*rooms_.at(message.roomId), message.bytes));
+        break;
+      case WorkerMessage::Type::Leave: {
+        Room& room = *rooms_.at(message.roomId);
+        const auto it = std::find_if(
+            room.members.begin(), room.members.end(), [&](const Member& m) {
+              return m.peer == kInvalidPeerId &&
+                     m.proxyWorker == message.fromWorker &&
+                     m.proxyId == message.proxyId;
+            });
+        if (it != room.members.end()) {
+          room.server.Leave(it->playerId);
+          room.members.erase(it);
+        }
+      } break;
+      case WorkerMessage::Type::Outbound:
+        if (const auto it = proxies_.find(message.proxyId);
+            it != proxies_.end()) {
+          transport_.Send(it->second, message.bytes, 0,
+                          message.packetFlags);
+        }
+        break;
+    }
+  }
+}
+
+}  // namespace mp
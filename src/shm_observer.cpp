@@ -0,0 +1,91 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "shm_world.hpp"
+
+namespace {
+
+using Reader = mp::ShmWorldReader<mp::WorldState::maxPlayers>;
+using Exporter = mp::ShmWorldExporter<mp::WorldState::maxPlayers>;
+
+// Reads the newest snapshot as fast as possible for `duration` and reports
+// how many reads and how many distinct server ticks were seen.
+void MeasureReads(const Reader& reader, const std::chrono::seconds duration) {
+  using Clock = std::chrono::steady_clock;
+  Reader::Snapshot snapshot{};
+  std::uint64_t reads = 0;
+  std::uint64_t distinctTicks = 0;
+  std::uint64_t lastGeneration = reader.Generation();
+
+  const auto start = Clock::now();
+  while (Clock::now() - start < duration) {
+    if (!reader.ReadLatest(snapshot)) continue;
+    ++reads;
+    if (const std::uint64_t generation = reader.Generation();
+        generation != lastGeneration) {
+      distinctTicks += generation - lastGeneration;
+      lastGeneration = generation;
+    }
+  }
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  if (reads == 0) {
+    std::cout << "no snapshots published yet\n";
+    return;
+  }
+
+  std::cout << "reads/s: " << static_cast<double>(reads) / seconds
+            << ", ns/read: " << seconds * 1e9 / static_cast<double>(reads)
+            << ", ticks/s: " << static_cast<double>(distinctTicks) / seconds
+            << ", last tick: " << snapshot.tick
+            << ", players: " << snapshot.world.playerCount
+            << ", score " << snapshot.world.goals[0] << ":"
+            << snapshot.world.goals[1] << "\n";
+}
+
+// Self-contained throughput run: an in-process writer publishes a full room
+// at full speed through a real segment while this thread reads it back.
+int RunBenchmark(const std::chrono::seconds duration) {
+  const std::string name = "/hockey2d-shm-bench-" + std::to_string(getpid());
+  Exporter exporter(name);
+  std::atomic<bool> bIsRunning = true;
+  std::thread writer([&exporter, &bIsRunning] {
+    mp::WorldState world;
+    world.players.resize(mp::WorldState::maxPlayers);
+    for (std::uint64_t tick = 0; bIsRunning; ++tick) {
+      world.puck.transform.pos.x = static_cast<float>(tick);
+      exporter.Publish(tick, world);
+    }
+  });
+
+  const Reader reader(name);
+  MeasureReads(reader, duration);
+
+  bIsRunning = false;
+  writer.join();
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  if (argc > 1 && std::string(argv[1]) == "--bench") {
+    return RunBenchmark(std::chrono::seconds(argc > 2 ? std::atoi(argv[2]) : 5));
+  }
+
+  const std::uint32_t roomId = argc > 1 ? std::atoi(argv[1]) : 0;
+  const Reader reader(mp::ShmWorldName(roomId));
+  std::cout << "Attached to " << mp::ShmWorldName(roomId) << "\n";
+  while (reader.IsAlive()) {
+    MeasureReads(reader, std::chrono::seconds(1));
+  }
+  std::cout << "Server closed the segment\n";
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "world_publisher.hpp"
+
+namespace mp {
+
+inline constexpr std::uint32_t kShmWorldMagic = 0x48324457;  // "H2DW"
+// fixed point builds keep the sizes but not the meaning of Player's fields
+inline constexpr std::uint32_t kShmWorldLayoutVersion =
+    std::is_same_v<Real, float> ? 3 : 0x10003;
+inline constexpr std::size_t kShmWorldSlots = 8;
+
+inline std::string ShmWorldName(const std::uint32_t roomId) {
+  return "/hockey2d-room-" + std::to_string(roomId);
+}
+
+// Fixed layout shared between the server and local observers. Tick snapshots
+// go into a ring of seqlocked slots; `generation` counts published ticks, so
+// the latest one lives in slot (generation - 1) % Slots.
+template <std::size_t MaxPlayers, std::size_t Slots = kShmWorldSlots>
+struct ShmWorldSegment {
+  using Snapshot = PublishedWorld<MaxPlayers>;
+
+  std::atomic<std::uint32_t> magic{0};
+  std::uint32_t layoutVersion{kShmWorldLayoutVersion};
+  std::uint32_t maxPlayers{MaxPlayers};
+  std::uint32_t slotCount{Slots};
+  std::uint64_t segmentSize{sizeof(ShmWorldSegment)};
+  alignas(64) std::atomic<std::uint64_t> generation{0};
+  std::array<SeqLock<Snapshot>, Slots> slots;
+};
+
+template <std::size_t MaxPlayers, std::size_t Slots = kShmWorldSlots>
+class ShmWorldExporter {
+ public:
+  using Segment = ShmWorldSegment<MaxPlayers, Slots>;
+  using Snapshot = typename Segment::Snapshot;
+
+  ShmWorldExporter(const ShmWorldExporter& other) = delete;
+  ShmWorldExporter& operator=(const ShmWorldExporter& other) = delete;
+
+  explicit ShmWorldExporter(std::string name) : name_(std::move(name)) {
+    const int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to create shared memory " + name_);
+    }
+    if (ftruncate(fd, sizeof(Segment)) != 0) {
+      close(fd);
+      shm_unlink(name_.c_str());
+      throw std::runtime_error("Failed to resize shared memory " + name_);
+    }
+    void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+      shm_unlink(name_.c_str());
+      throw std::runtime_error("Failed to map shared memory " + name_);
+    }
+    segment_ = new (memory) Segment{};
+    segment_->magic.store(kShmWorldMagic, std::memory_order_release);
+  }
+
+  ~ShmWorldExporter() {
+    segment_->magic.store(0, std::memory_order_release);
+    segment_->~Segment();
+    munmap(segment_, sizeof(Segment));
+    shm_unlink(name_.c_str());
+  }
+
+  void Publish(const std::uint64_t tick, const WorldState& world) {
+    const std::uint64_t generation =
+        segment_->generation.load(std::memory_order_relaxed);
+    staging_.Assign(tick, world);
+    segment_->slots[generation % Slots].Publish(staging_);
+    segment_->generation.store(generation + 1, std::memory_order_release);
+  }
+
+ private:
+  std::string name_;
+  Segment* segment_{nullptr};
+  Snapshot staging_{};
+};
+
+// Read side used by sidecar processes; it maps the segment read-only and
+// never writes to it, so any number of observers can attach.
+template <std::size_t MaxPlayers, std::size_t Slots = kShmWorldSlots>
+class ShmWorldReader {
+ public:
+  using Segment = ShmWorldSegment<MaxPlayers, Slots>;
+  using Snapshot = typename Segment::Snapshot;
+
+  ShmWorldReader(const ShmWorldReader& other) = delete;
+  ShmWorldReader& operator=(const ShmWorldReader& other) = delete;
+
+  explicit ShmWorldReader(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("No shared memory world named " + name);
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(Segment)) {
+      close(fd);
+      throw std::runtime_error("Shared memory world has unexpected size");
+    }
+    void* memory = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+      throw std::runtime_error("Failed to map shared memory " + name);
+    }
+    segment_ = static_cast<const Segment*>(memory);
+    if (segment_->magic.load(std::memory_order_acquire) != kShmWorldMagic ||
+        segment_->layoutVersion != kShmWorldLayoutVersion ||
+        segment_->maxPlayers != MaxPlayers || segment_->slotCount != Slots ||
+        segment_->segmentSize != sizeof(Segment)) {
+      munmap(const_cast<Segment*>(segment_), sizeof(Segment));
+      throw std::runtime_error("Shared memory world layout mismatch");
+    }
+  }
+
+  ~ShmWorldReader() { munmap(const_cast<Segment*>(segment_), sizeof(Segment)); }
+
+  // Number of ticks published so far; stays 0 until the first tick.
+  [[nodiscard]]
+  std::uint64_t Generation() const {
+    return segment_->generation.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]]
+  bool IsAlive() const {
+    return segment_->magic.load(std::memory_order_acquire) == kShmWorldMagic;
+  }
+
+  // Copies the newest complete snapshot; false if nothing is published yet.
+  bool ReadLatest(Snapshot& out) const {
+    for (;;) {
+      const std::uint64_t generation = Generation();
+      if (generation == 0) return false;
+      if (segment_->slots[(generation - 1) % Slots].TryRead(out)) return true;
+    }
+  }
+
+  // Copies the snapshot published as the `generation`-th tick if it is still
+  // in the ring; false once the writer has lapped it.
+  bool ReadGeneration(const std::uint64_t generation, Snapshot& out) const {
+    if (generation == 0) return false;
+    // every slot is written once per lap, so its sequence pins the generation
+    const auto& slot = segment_->slots[(generation - 1) % Slots];
+    const std::uint64_t expected = 2 * ((generation - 1) / Slots + 1);
+    for (;;) {
+      const std::uint64_t sequence = slot.Sequence();
+      if (sequence > expected || sequence + 1 < expected) return false;
+      if (sequence == expected && slot.TryRead(out) &&
+          slot.Sequence() == expected) {
+        return true;
+      }
+    }
+  }
+
+ private:
+  const Segment* segment_{nullptr};
+};
+
+}  // namespace mp
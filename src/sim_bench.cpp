@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "cereal/external/rapidjson/document.h"
+#include "cereal/external/rapidjson/istreamwrapper.h"
+#include "cereal/external/rapidjson/ostreamwrapper.h"
+#include "cereal/external/rapidjson/prettywriter.h"
+#include "flat_world.hpp"
+#include "float_env.hpp"
+#include "lag_compensation.hpp"
+#include "sim_scenarios.hpp"
+#include "simulation.hpp"
+#include "world_hash.hpp"
+#include "world_history.hpp"
+
+// Cost of one sim step over the generated scenarios. Results go out as JSON
+// and can be checked against a stored run, failing when a case got slower
+// than the tolerance allows or started allocating more.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSchemaVersion = 1;
+
+volatile std::uint64_t gSink = 0;
+volatile float gContactSink = 0;
+
+struct BenchOptions {
+  std::uint64_t ticks{2000};
+  std::uint64_t warmupTicks{200};
+  int repeat{5};
+  std::uint64_t seed{1};
+  std::string filter;  // substring of the case names to run
+  std::string outputPath;  // empty: stdout
+  std::string baselinePath;
+  double tolerance{0.1};
+};
+
+BenchOptions ParseOptions(const int argc, char* argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const auto value = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + std::string(arg));
+      }
+      return argv[++i];
+    };
+    if (arg == "--ticks") {
+      options.ticks = std::max(1ull, std::strtoull(value(), nullptr, 10));
+    } else if (arg == "--warmup") {
+      options.warmupTicks = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--repeat") {
+      options.repeat = std::max(1, std::atoi(value()));
+    } else if (arg == "--seed") {
+      options.seed = std::strtoull(value(), nullptr, 10);
+    } else if (arg == "--filter") {
+      options.filter = value();
+    } else if (arg == "--out") {
+      options.outputPath = value();
+    } else if (arg == "--baseline") {
+      options.baselinePath = value();
+    } else if (arg == "--tolerance") {
+      options.tolerance = std::max(0.0, std::atof(value()));
+    } else {
+      throw std::runtime_error(
+          "Usage: sim_bench [--ticks n] [--warmup n] [--repeat n] [--seed n] "
+          "[--filter name] [--out file.json] [--baseline file.json] "
+          "[--tolerance 0.1]");
+    }
+  }
+  return options;
+}
+
+struct BenchCase {
+  std::string name;
+  std::size_t bodies;
+  std::function<void()> step;  // advances the case by one tick
+  bool bFlushesDenormals{true};  // as on the server's sim threads
+};
+
+// A scenario stepped by StepWorld with scripted inputs, or none at all. Cases
+// that measure a transient rewind to their first tick every `rewindEvery`
+// ticks.
+struct SimCase {
+  SimCase(const std::string_view name, const std::uint64_t seed,
+          const std::uint64_t rewindEvery, const bool bHasInput = true,
+          const std::size_t solverThreads = 1)
+      : initial(mp::GenerateScenario(name, seed)),
+        world(initial),
+        spawnArea(seed),
+        contactSolver(solverThreads),
+        seed(seed),
+        rewindEvery(rewindEvery),
+        bHasInput(bHasInput) {}
+
+  void Step() {
+    if (rewindEvery && tick % rewindEvery == 0) world = initial;
+    if (bHasInput) mp::ApplyScenarioInput(world, seed, tick);
+    mp::StepWorld(world, spawnArea, tick + 1, contactSolver);
+    ++tick;
+  }
+
+  mp::WorldState initial;
+  mp::WorldState world;
+  mp::SpawnArea spawnArea;
+  mp::ContactSolver contactSolver;
+  std::uint64_t seed;
+  std::uint64_t rewindEvery;
+  bool bHasInput;
+  std::uint64_t tick{0};
+};
+
+// A crowd of `players` with the puck put behind a goal line before every
+// step, so that each tick scores and respawns everyone.
+struct GoalCase {
+  GoalCase(const std::uint32_t players, const std::uint64_t seed)
+      : spawnArea(seed) {
+    world.players.resize(players);
+    for (std::uint32_t i = 0; i < players; ++i) {
+      world.players[i].id = i;
+      world.players[i].teamId = i % 2;
+    }
+    spawnArea.ResetTeams(world.players, 0);
+  }
+
+  void Step() {
+    world.puck.transform.pos = {0.0f, -0.9f};
+    mp::StepWorld(world, spawnArea, ++tick, contactSolver);
+  }
+
+  void Respawn() { spawnArea.ResetTeams(world.players, ++tick); }
+
+  mp::WorldState world;
+  mp::SpawnArea spawnArea;
+  mp::ContactSolver contactSolver;
+  std::uint64_t tick{0};
+};
+
+// A 5v5 room idle for long enough that damping has left every velocity on a
+// subnormal that no longer decays, stepped the way the sim did before bodies
+// went to sleep and snapped to rest: damped forever. Goals are left out, an
+// idle room scores none.
+struct LegacyIdleCase {
+  explicit LegacyIdleCase(const std::uint64_t seed)
+      : world(mp::GenerateScenario("5v5", seed)) {
+    // 20 ulps of the smallest subnormal: 20 * 0.99 rounds back to 20
+    const float stuck = 20 * std::numeric_limits<float>::denorm_min();
+    for (mp::Player& player : world.players) {
+      player.transform.velocity = {stuck, -stuck};
+    }
+    world.puck.transform.velocity = {-stuck, stuck};
+  }
+
+  void Step() {
+    auto& puck = world.puck.transform;
+    for (mp::Player& player : world.players) {
+      auto& body = player.transform;
+      if (mp::IsColliding(body.pos, body.radius, puck.pos, puck.radius)) {
+        mp::CalculateCollisionResponse(body, puck);
+      }
+      for (mp::Player& other : world.players) {
+        if (other.id > player.id &&
+            mp::IsColliding(body.pos, body.radius, other.transform.pos,
+                            other.transform.radius)) {
+          mp::CalculateCollisionResponse(body, other.transform);
+        }
+      }
+      Move(body);
+    }
+    Move(puck);
+  }
+
+  static void Move(mp::MoveableObject& body) {
+    mp::HandleCollisionWithBorder(body, mp::WorldState::fieldBorders[0],
+                                  mp::WorldState::fieldBorders[1]);
+    body.pos += body.velocity * mp::kBaseSpeed;
+    body.velocity *= 0.99f;
+  }
+
+  mp::WorldState world;
+};
+
+std::vector<BenchCase> MakeCases(const std::uint64_t seed) {
+  std::vector<BenchCase> cases;
+  for (const std::string_view name : mp::kScenarioNames) {
+    // overlapping spawns push apart within a few ticks
+    const std::uint64_t rewindEvery = name == "spawn-overlap" ? 16 : 0;
+    auto state = std::make_shared<SimCase>(name, seed, rewindEvery);
+    cases.push_back({std::string(name), state->world.players.size() + 1,
+                     [state] { state->Step(); }});
+  }
+  // the standard modes on the generic contact path instead of their kernels
+  for (const std::string_view name : {"1v1", "2v2", "5v5"}) {
+    auto state = std::make_shared<SimCase>(name, seed, 0);
+    state->contactSolver.SetFixedKernels(false);
+    cases.push_back({std::string(name) + "/generic",
+                     state->world.players.size() + 1,
+                     [state] { state->Step(); }});
+  }
+  // the crowded scenarios with the contact solver split across threads
+  for (const std::string_view name : {"ffa-100", "puck-field"}) {
+    for (const std::size_t threads : {2, 4}) {
+      auto state = std::make_shared<SimCase>(name, seed, 0, true, threads);
+      cases.push_back({std::string(name) + "/threads-" +
+                           std::to_string(threads),
+                       state->world.players.size() + 1,
+                       [state] { state->Step(); }});
+    }
+  }
+  // a 5v5 room nobody touches, asleep after the warmup
+  {
+    auto state = std::make_shared<SimCase>("5v5", seed, 0, false);
+    cases.push_back({"lobby-5v5", state->world.players.size() + 1,
+                     [state] { state->Step(); }});
+  }
+  // A long-idle room before rest snapping, with and without flush-to-zero,
+  // and the same room stepped by StepWorld. A Fixed has no subnormals.
+  if constexpr (std::is_floating_point_v<mp::Real>) {
+    for (const bool bFlushes : {false, true}) {
+      auto state = std::make_shared<LegacyIdleCase>(seed);
+      cases.push_back({bFlushes ? "long-idle/legacy-ftz" : "long-idle/legacy",
+                       state->world.players.size() + 1,
+                       [state] { state->Step(); }, bFlushes});
+    }
+    auto state = std::make_shared<SimCase>("5v5", seed, 0, false);
+    state->world = LegacyIdleCase(seed).world;
+    cases.push_back({"long-idle", state->world.players.size() + 1,
+                     [state] { state->Step(); }});
+  }
+  // A goal on every tick: the reset tick as a whole, and the respawn alone.
+  for (const std::uint32_t players : {10u, 100u, 1000u}) {
+    auto state = std::make_shared<GoalCase>(players, seed);
+    cases.push_back({"goal-reset/" + std::to_string(players), players + 1,
+                     [state] { state->Step(); }});
+    cases.push_back({"respawn/" + std::to_string(players), players + 1,
+                     [state] { state->Respawn(); }});
+  }
+  // the per-tick desync hash alone, to hold against the step above
+  for (const std::string_view name : mp::kScenarioNames) {
+    auto world = std::make_shared<mp::WorldState>(
+        mp::GenerateScenario(name, seed));
+    cases.push_back({"hash/" + std::string(name), world->players.size() + 1,
+                     [world] { gSink = mp::HashWorld(*world); }});
+  }
+  // A 5v5 world saved and restored, as prediction and rollback do every
+  // tick: the vector-backed state, a fresh copy each save as a history of
+  // them would keep, against the flat one.
+  {
+    auto world =
+        std::make_shared<mp::WorldState>(mp::GenerateScenario("5v5", seed));
+    const std::size_t bodies = world->players.size() + 1;
+    cases.push_back({"save-restore/vector", bodies, [world] {
+                       const mp::WorldState saved = *world;
+                       *world = saved;
+                       gSink = world->players.size();
+                     }});
+    auto flat = std::make_shared<mp::FlatWorldState>();
+    flat->Assign(*world);
+    auto saved = std::make_shared<mp::FlatWorldState>();
+    cases.push_back({"save-restore/flat", bodies, [flat, saved] {
+                       saved->CopyFrom(*flat);
+                       flat->CopyFrom(*saved);
+                       gSink = flat->playerCount;
+                     }});
+    // a room's history of it: a tick recorded, the oldest one kept restored
+    auto history = std::make_shared<mp::WorldHistory>(
+        mp::kWorldHistoryDepth, std::chrono::microseconds{10'000});
+    auto tick = std::make_shared<std::uint64_t>(0);
+    for (std::size_t i = 0; i < history->Capacity(); ++i) {
+      history->Record(++*tick, *world);
+    }
+    cases.push_back({"history/record", bodies, [world, history, tick] {
+                       history->Record(++*tick, *world);
+                     }});
+    auto restored = std::make_shared<mp::WorldState>(*world);
+    cases.push_back({"history/restore", bodies, [history, restored] {
+                       gSink = history->Restore(history->OldestTick(),
+                                                *restored);
+                     }});
+  }
+  // One lag compensated input per player and tick, each reaching a
+  // different distance back. The puck passed just in front of the first
+  // players at the ticks they ask for, so they hit and the rest miss;
+  // ns/body is the cost of one input.
+  for (const std::uint32_t players : {10u, 100u, 1000u}) {
+    auto state = std::make_shared<GoalCase>(players, seed);
+    auto compensator = std::make_shared<mp::LagCompensator>(
+        mp::kMaxLagCompensation, std::chrono::microseconds{10'000});
+    const std::size_t window = compensator->WindowTicks();
+    for (std::uint64_t tick = 1; tick <= window; ++tick) {
+      const mp::Player& player =
+          state->world.players[(tick - 1) % state->world.players.size()];
+      compensator->Record(tick, player.transform.pos + mp::Vector2{.06f, 0});
+    }
+    for (mp::Player& player : state->world.players) {
+      player.transform.velocity = {1, 0};
+    }
+    cases.push_back(
+        {"lag-comp/" + std::to_string(players), players,
+         [state, compensator, window] {
+           std::uint64_t hits = 0;
+           for (std::size_t i = 0; i < state->world.players.size(); ++i) {
+             mp::MoveableObject player = state->world.players[i].transform;
+             mp::MoveableObject puck = state->world.puck.transform;
+             hits += compensator->CompensateHit(player, puck,
+                                                1 + i % (window - 1));
+           }
+           gSink = hits;
+         }});
+  }
+  // Wall contacts of points spread over the rink and a little past it: the
+  // baked field against the exact per-segment query it is baked from.
+  {
+    constexpr std::size_t kPoints = 1000;
+    constexpr mp::SpawnRange kSpread{-1.05, 1.05};
+    auto points = std::make_shared<std::vector<mp::Vector2>>();
+    mp::CounterRng rng(seed, 0, 0);
+    for (std::size_t i = 0; i < kPoints; ++i) {
+      const mp::Real x = mp::SampleCoordinate<mp::Real>(kSpread, rng);
+      points->push_back({x, mp::SampleCoordinate<mp::Real>(kSpread, rng)});
+    }
+    const auto contacts = [points](const auto& query) {
+      mp::Real sum = 0;
+      for (const mp::Vector2& point : *points) {
+        const mp::RinkContact contact = query(point);
+        sum += contact.distance + contact.normal.x + contact.normal.y;
+      }
+      gContactSink = mp::ToFloat(sum);
+    };
+    const mp::RinkField& field = mp::DefaultRinkField<mp::Real>();
+    const mp::Rink& rink = mp::DefaultRink<mp::Real>();
+    cases.push_back({"rink-field/" + std::to_string(kPoints), kPoints,
+                     [contacts, &field] {
+                       contacts([&](const mp::Vector2 point) {
+                         return field.Sample(point);
+                       });
+                     }});
+    cases.push_back({"rink-segments/" + std::to_string(kPoints), kPoints,
+                     [contacts, &rink] {
+                       contacts([&](const mp::Vector2 point) {
+                         return rink.Query(point);
+                       });
+                     }});
+  }
+  return cases;
+}
+
+struct BenchResult {
+  std::string name;
+  std::size_t bodies;
+  double nsPerTick;
+  double allocsPerTick;
+};
+
+BenchResult Measure(const BenchCase& benchCase, const BenchOptions& options) {
+  const bool bWasFlushing = mp::SetDenormalFlush(benchCase.bFlushesDenormals);
+  for (std::uint64_t i = 0; i < options.warmupTicks; ++i) benchCase.step();
+
+  std::vector<double> nsPerTick;
+  std::uint64_t allocations = 0;
+  for (int run = 0; run < options.repeat; ++run) {
+    const std::uint64_t allocationsBefore = mp::HeapAllocations();
+    const auto start = Clock::now();
+    for (std::uint64_t i = 0; i < options.ticks; ++i) benchCase.step();
+    const auto elapsed = Clock::now() - start;
+    allocations += mp::HeapAllocations() - allocationsBefore;
+    nsPerTick.push_back(
+        std::chrono::duration<double, std::nano>(elapsed).count() /
+        static_cast<double>(options.ticks));
+  }
+  mp::SetDenormalFlush(bWasFlushing);
+  std::ranges::sort(nsPerTick);
+  return {benchCase.name, benchCase.bodies, nsPerTick[nsPerTick.size() / 2],
+          static_cast<double>(allocations) /
+              static_cast<double>(options.ticks * options.repeat)};
+}
+
+template <typename Writer>
+void WriteResults(Writer& writer, const BenchOptions& options,
+                  const std::vector<BenchResult>& results) {
+  writer.StartObject();
+  writer.Key("schema");
+  writer.Int(kSchemaVersion);
+  writer.Key("ticks");
+  writer.Uint64(options.ticks);
+  writer.Key("repeat");
+  writer.Int(options.repeat);
+  writer.Key("seed");
+  writer.Uint64(options.seed);
+  writer.Key("results");
+  writer.StartArray();
+  for (const BenchResult& result : results) {
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(result.name.c_str());
+    writer.Key("bodies");
+    writer.Uint64(result.bodies);
+    writer.Key("nsPerTick");
+    writer.Double(result.nsPerTick);
+    writer.Key("nsPerBody");
+    writer.Double(result.nsPerTick / static_cast<double>(result.bodies));
+    writer.Key("allocsPerTick");
+    writer.Double(result.allocsPerTick);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+}
+
+rapidjson::Document LoadBaseline(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) throw std::runtime_error("Failed to open " + path);
+  rapidjson::IStreamWrapper stream(file);
+  rapidjson::Document baseline;
+  baseline.ParseStream(stream);
+  if (baseline.HasParseError() || !baseline.IsObject() ||
+      !baseline.HasMember("schema") || !baseline["schema"].IsInt() ||
+      baseline["schema"].GetInt() != kSchemaVersion ||
+      !baseline.HasMember("results") || !baseline["results"].IsArray()) {
+    throw std::runtime_error(path + " is not a sim_bench result file");
+  }
+  return baseline;
+}
+
+// Prints each case against the baseline; returns the number of regressions.
+int CompareToBaseline(const rapidjson::Document& baseline,
+                      const std::vector<BenchResult>& results,
+                      const double tolerance) {
+  int regressions = 0;
+  for (const BenchResult& result : results) {
+    const rapidjson::Value* stored = nullptr;
+    for (const rapidjson::Value& entry : baseline["results"].GetArray()) {
+      if (entry.IsObject() && entry.HasMember("name") &&
+          entry["name"].IsString() &&
+          result.name == entry["name"].GetString()) {
+        stored = &entry;
+        break;
+      }
+    }
+    std::cerr << std::setw(20) << std::left << result.name << std::right;
+    if (!stored || !stored->HasMember("nsPerTick") ||
+        !(*stored)["nsPerTick"].IsNumber() ||
+        !stored->HasMember("allocsPerTick") ||
+        !(*stored)["allocsPerTick"].IsNumber()) {
+      std::cerr << " not in baseline\n";
+      continue;
+    }
+    const double storedNs = (*stored)["nsPerTick"].GetDouble();
+    const double storedAllocs = (*stored)["allocsPerTick"].GetDouble();
+    const double ratio = storedNs > 0 ? result.nsPerTick / storedNs : 1.0;
+    const bool bSlower = ratio > 1.0 + tolerance;
+    // allocation counts are exact, any growth is a regression
+    const bool bAllocates = result.allocsPerTick > storedAllocs + 1e-9;
+    std::cerr << std::fixed << std::setprecision(1) << std::setw(12)
+              << storedNs << " -> " << std::setw(12) << result.nsPerTick
+              << " ns/tick (" << std::showpos << (ratio - 1.0) * 100
+              << std::noshowpos << "%)" << std::setprecision(3)
+              << ", allocs/tick " << storedAllocs << " -> "
+              << result.allocsPerTick << std::defaultfloat
+              << (bSlower || bAllocates ? "  REGRESSION" : "") << "\n";
+    if (bSlower || bAllocates) ++regressions;
+  }
+  return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) try {
+  const BenchOptions options = ParseOptions(argc, argv);
+  // load it first, a bad path should not cost a whole run
+  std::optional<rapidjson::Document> baseline;
+  if (!options.baselinePath.empty()) {
+    baseline = LoadBaseline(options.baselinePath);
+  }
+
+  std::vector<BenchResult> results;
+  for (const BenchCase& benchCase : MakeCases(options.seed)) {
+    if (benchCase.name.find(options.filter) == std::string::npos) continue;
+    results.push_back(Measure(benchCase, options));
+    const BenchResult& result = results.back();
+    std::cerr << std::setw(20) << std::left << result.name << std::right
+              << std::fixed << std::setprecision(1) << std::setw(5)
+              << result.bodies << " bodies " << std::setw(12)
+              << result.nsPerTick << " ns/tick " << std::setw(8)
+              << result.nsPerTick / static_cast<double>(result.bodies)
+              << " ns/body " << std::setprecision(3) << result.allocsPerTick
+              << " allocs/tick\n"
+              << std::defaultfloat;
+  }
+
+  std::ofstream file;
+  if (!options.outputPath.empty()) {
+    file.open(options.outputPath);
+    if (!file) throw std::runtime_error("Failed to open " + options.outputPath);
+  }
+  std::ostream& out = options.outputPath.empty() ? std::cout : file;
+  rapidjson::OStreamWrapper stream(out);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  WriteResults(writer, options, results);
+  out << "\n";
+
+  if (baseline) {
+    const int regressions =
+        CompareToBaseline(*baseline, results, options.tolerance);
+    if (regressions) {
+      std::cerr << regressions << " case(s) regressed against "
+                << options.baselinePath << "\n";
+      return 1;
+    }
+  }
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << e.what() << "\n";
+  return 1;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace mp {
+
+// Time source of the server loop and the transports around it. Swapping the
+// system clock for a virtual one runs a headless match as fast as the cpu
+// allows: nothing sleeps, time jumps to the next deadline instead.
+class SimClock {
+ public:
+  using time_point = std::chrono::steady_clock::time_point;
+
+  virtual ~SimClock() = default;
+
+  [[nodiscard]]
+  virtual time_point Now() const = 0;
+
+  virtual void SleepUntil(time_point deadline) = 0;
+
+  // False for clocks that only move when someone sleeps on them.
+  [[nodiscard]]
+  virtual bool IsRealTime() const = 0;
+};
+
+class SystemClock final : public SimClock {
+ public:
+  [[nodiscard]]
+  static SystemClock& Instance() {
+    static SystemClock clock;
+    return clock;
+  }
+
+  [[nodiscard]]
+  time_point Now() const override {
+    return std::chrono::steady_clock::now();
+  }
+
+  void SleepUntil(const time_point deadline) override {
+    std::this_thread::sleep_until(deadline);
+  }
+
+  [[nodiscard]]
+  bool IsRealTime() const override {
+    return true;
+  }
+};
+
+// Time that stands still until a SleepUntil moves it forward. Meant for one
+// thread driving the server and its clients in turn; Now may be read from
+// others.
+class VirtualClock final : public SimClock {
+ public:
+  VirtualClock(const VirtualClock& other) = delete;
+  VirtualClock& operator=(const VirtualClock& other) = delete;
+
+  explicit VirtualClock(const time_point start = time_point{})
+      : now_(start.time_since_epoch().count()) {}
+
+  [[nodiscard]]
+  time_point Now() const override {
+    return time_point(
+        time_point::duration(now_.load(std::memory_order_acquire)));
+  }
+
+  void SleepUntil(const time_point deadline) override {
+    const auto target = deadline.time_since_epoch().count();
+    auto current = now_.load(std::memory_order_relaxed);
+    // never backwards
+    while (current < target &&
+           !now_.compare_exchange_weak(current, target,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  void Advance(const std::chrono::nanoseconds duration) {
+    SleepUntil(Now() + duration);
+  }
+
+  [[nodiscard]]
+  bool IsRealTime() const override {
+    return false;
+  }
+
+ private:
+  std::atomic<time_point::rep> now_;
+};
+
+}  // namespace mp
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "counter_rng.hpp"
+#include "game_data.hpp"
+#include "simulation.hpp"
+
+namespace mp {
+
+// Worlds for benchmarking and replaying the sim. The same name and seed
+// always give the same world.
+inline constexpr std::array<std::string_view, 7> kScenarioNames{
+    "idle",    "1v1",        "2v2",          "5v5",
+    "ffa-100", "puck-field", "spawn-overlap",
+};
+
+// Ticks between two scripted inputs of a player.
+constexpr std::uint64_t kScenarioInputPeriod = 6;
+
+namespace detail {
+
+inline void AddPlayers(WorldState& world, const std::uint64_t seed,
+                       const std::uint32_t count,
+                       const MoveableObject& body = Player{}.transform) {
+  world.players.reserve(world.players.size() + count);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    Player player{.id = static_cast<std::uint32_t>(world.players.size()),
+                  .teamId = i % 2,
+                  .transform = body};
+    // rejection sampling keeps the bodies apart whatever their size
+    CounterRng rng(seed, 0, player.id);
+    ResetPlayerPos(player, SpawnArea::kXRange,
+                   SpawnArea::kTeamYRanges[player.teamId], rng, world.players);
+    world.players.push_back(player);
+  }
+}
+
+}  // namespace detail
+
+[[nodiscard]]
+inline WorldState GenerateScenario(const std::string_view name,
+                                   const std::uint64_t seed) {
+  WorldState world;
+  if (name == "idle") {
+    // nobody joined, the puck rests at the center
+  } else if (name == "1v1") {
+    detail::AddPlayers(world, seed, 2);
+  } else if (name == "2v2") {
+    detail::AddPlayers(world, seed, 4);
+  } else if (name == "5v5") {
+    detail::AddPlayers(world, seed, 10);
+  } else if (name == "ffa-100") {
+    // everyone everywhere; teams only matter for the goal respawn
+    constexpr SpawnRange y{
+        ToFloat(WorldState::fieldBorders[1].x) + Player::baseRadius,
+        ToFloat(WorldState::fieldBorders[1].y) - Player::baseRadius};
+    world.players.reserve(100);
+    for (std::uint32_t i = 0; i < 100; ++i) {
+      Player player{.id = i, .teamId = i % 2};
+      CounterRng rng(seed, 0, i);
+      ResetPlayerPos(player, SpawnArea::kXRange, y, rng, world.players);
+      world.players.push_back(player);
+    }
+  } else if (name == "puck-field") {
+    // The sim has a single puck, so the stress field is 200 player bodies
+    // with a puck's size and mass.
+    detail::AddPlayers(world, seed, 200, Puck{}.transform);
+  } else if (name == "spawn-overlap") {
+    // every player and the puck start inside one player radius
+    for (std::uint32_t i = 0; i < 20; ++i) {
+      Player player{.id = i, .teamId = i % 2};
+      CounterRng rng(seed, 0, i);
+      player.transform.pos = {static_cast<float>(rng.Uniform(-.01, .01)),
+                              static_cast<float>(rng.Uniform(-.01, .01))};
+      world.players.push_back(player);
+    }
+  } else {
+    throw std::runtime_error("Unknown scenario " + std::string(name));
+  }
+  return world;
+}
+
+// Keyboard-like input: every kScenarioInputPeriod ticks each player picks
+// one of eight directions or stands still, as a client's input would set.
+inline void ApplyScenarioInput(WorldState& world, const std::uint64_t seed,
+                               const std::uint64_t tick) {
+  static constexpr float kDiagonal = 0.70710678f;
+  static constexpr std::array<Vector2, 9> kDirections{{
+      {1, 0},
+      {kDiagonal, kDiagonal},
+      {0, 1},
+      {-kDiagonal, kDiagonal},
+      {-1, 0},
+      {-kDiagonal, -kDiagonal},
+      {0, -1},
+      {kDiagonal, -kDiagonal},
+      {0, 0},
+  }};
+  if (tick % kScenarioInputPeriod != 0) return;
+  const std::uint64_t round =
+      SplitMix64(seed ^ (tick / kScenarioInputPeriod));
+  for (Player& player : world.players) {
+    const std::uint64_t bits = SplitMix64(round + player.id);
+    player.transform.velocity = kDirections[bits % kDirections.size()];
+  }
+}
+
+}  // namespace mp
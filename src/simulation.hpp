@@ -0,0 +1,745 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "counter_rng.hpp"
+#include "game_data.hpp"
+#include "rink.hpp"
+#include "worker_team.hpp"
+
+namespace mp {
+
+constexpr float kBaseSpeed = .005f;
+
+constexpr float kFrictionCoefficient = 0.01f;
+
+constexpr float kRestitution = 0.9f;
+
+// A body slower than kSleepSpeed for kSleepTicks ticks falls asleep: its
+// velocity snaps to zero and it is no longer integrated, damped, tested
+// against the border or against other sleepers. A contact, an input or a
+// respawn wakes it up.
+constexpr float kSleepSpeed = .005f;
+constexpr std::uint32_t kSleepTicks = 30;
+
+// Float velocity components below kRestSnap snap to zero on every move. The
+// 0.99 damping alone never gets there: it drags a component into the
+// subnormal range, where the smallest values round back to themselves, and
+// a body gliding along one axis carries that subnormal on the other one for
+// as long as it stays awake. A Fixed truncates to zero by itself.
+constexpr float kRestSnap = 1e-6f;
+
+// The sim is written once for both physics scalars, float and Fixed; the
+// server steps mp::WorldState, i.e. whichever one Real selects.
+
+template <typename T>
+bool IsColliding(const mp::BasicVector2<T> aPos,
+                 const std::type_identity_t<T> aRadius,
+                 const mp::BasicVector2<T> bPos,
+                 const std::type_identity_t<T> bRadius) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return (aPos - bPos).Length() < (aRadius + bRadius);
+  } else {
+    // floor(sqrt(d)) < r exactly when d < r * r, so no square root
+    const mp::BasicVector2<T> delta = aPos - bPos;
+    const std::int64_t reach = (aRadius + bRadius).RawValue();
+    return reach > 0 && RawLengthSquared(delta.x, delta.y) <
+                            static_cast<std::uint64_t>(reach * reach);
+  }
+}
+
+// Returns whether the bodies were approaching, i.e. whether it changed them.
+template <typename T>
+bool CalculateCollisionResponse(mp::BasicMoveableObject<T>& lhs,
+                                mp::BasicMoveableObject<T>& rhs) {
+  const mp::BasicVector2<T> normal = (rhs.pos - lhs.pos).Normalize();
+  const T relativeVelocity = (rhs.velocity - lhs.velocity).DotProduct(normal);
+  if (relativeVelocity > 0) return false;
+
+  const T impulseMagnitude =
+      -(1 + kRestitution) * relativeVelocity / (1 / lhs.mass + 1 / rhs.mass);
+
+  const mp::BasicVector2<T> impulse = impulseMagnitude * normal;
+
+  lhs.velocity -= impulse / lhs.mass;
+  rhs.velocity += impulse / rhs.mass;
+  return relativeVelocity < 0;
+}
+
+template <typename T>
+void HandleCollisionWithBorder(mp::BasicMoveableObject<T>& c,
+                               const mp::BasicVector2<T>& leftRight,
+                               const mp::BasicVector2<T>& topBottom) {
+  if (c.pos.x - c.radius < leftRight.x) {
+    c.pos.x = leftRight.x + c.radius;
+    c.velocity.x = -c.velocity.x;
+  } else if (c.pos.x + c.radius > leftRight.y) {
+    c.pos.x = leftRight.y - c.radius;
+    c.velocity.x = -c.velocity.x;
+  }
+
+  if (c.pos.y - c.radius < topBottom.x) {
+    c.pos.y = topBottom.x + c.radius;
+    c.velocity.y = -c.velocity.y;
+  } else if (c.pos.y + c.radius > topBottom.y) {
+    c.pos.y = topBottom.y - c.radius;
+    c.velocity.y = -c.velocity.y;
+  }
+}
+
+template <typename T>
+[[nodiscard]]
+constexpr bool IsAsleep(const mp::BasicMoveableObject<T>& body) {
+  return body.restTicks >= kSleepTicks;
+}
+
+template <typename T>
+[[nodiscard]]
+bool IsResting(const mp::BasicVector2<T> velocity) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return velocity.LengthDoubled() < kSleepSpeed * kSleepSpeed;
+  } else {
+    const std::int64_t limit = T(kSleepSpeed).RawValue();
+    return RawLengthSquared(velocity.x, velocity.y) <
+           static_cast<std::uint64_t>(limit * limit);
+  }
+}
+
+// Walls of any shape with one field lookup: a body reaching into a wall is
+// pushed back out along the normal and loses the part of its velocity that
+// heads into the wall, mirrored.
+template <typename T>
+void HandleCollisionWithRink(mp::BasicMoveableObject<T>& body,
+                             const mp::BasicRinkField<T>& rink) {
+  const mp::BasicRinkContact<T> contact = rink.Sample(body.pos);
+  const T depth = contact.distance + body.radius;
+  if (!(depth > 0)) return;
+  body.pos -= contact.normal * depth;
+  const T speed = body.velocity.DotProduct(contact.normal);
+  if (speed > 0) body.velocity -= contact.normal * (2 * speed);
+}
+
+// Walls, integration and friction of an awake body, then its rest count.
+template <typename T>
+void MoveBody(mp::BasicMoveableObject<T>& body,
+              const mp::BasicRinkField<T>& rink) {
+  if (IsAsleep(body)) {
+    if (body.restTicks != std::numeric_limits<std::uint32_t>::max()) {
+      body.restTicks++;
+    }
+    return;
+  }
+  HandleCollisionWithRink(body, rink);
+  body.pos += body.velocity * kBaseSpeed;
+  body.velocity *= 0.99f;
+  if constexpr (std::is_floating_point_v<T>) {
+    if (std::abs(body.velocity.x) < kRestSnap) body.velocity.x = 0.0f;
+    if (std::abs(body.velocity.y) < kRestSnap) body.velocity.y = 0.0f;
+  }
+  if (!IsResting(body.velocity)) {
+    body.restTicks = 0;
+  } else if (++body.restTicks == kSleepTicks) {
+    body.velocity = {0.0f, 0.0f};
+  }
+}
+
+// [low, high) along one axis.
+struct SpawnRange {
+  double low;
+  double high;
+};
+
+// Integer math for a Fixed, so that spawns replay bit-identically too.
+template <typename T>
+T SampleCoordinate(const SpawnRange& range, CounterRng& rng) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<T>(rng.Uniform(range.low, range.high));
+  } else {
+    const std::int64_t low = T(range.low).RawValue();
+    const std::int64_t span = T(range.high).RawValue() - low;
+    return T::FromRaw(static_cast<typename T::Raw>(
+        low + static_cast<std::int64_t>(rng() % static_cast<std::uint64_t>(
+                                                    span > 0 ? span : 1))));
+  }
+}
+
+// Draws candidates from `rng` until one is clear of every player. Unbounded
+// once the range is crowded; the server spawns on SpawnArea's slots.
+template <typename T>
+void ResetPlayerPos(mp::BasicPlayer<T>& newPlayer, const SpawnRange& xRange,
+                    const SpawnRange& yRange, CounterRng& rng,
+                    const std::vector<mp::BasicPlayer<T>>& players) {
+  bool bFoundPos = false;
+  newPlayer.transform.velocity = {0.0f, 0.0f};
+  newPlayer.transform.restTicks = 0;
+  while (!bFoundPos) {
+    const T x = SampleCoordinate<T>(xRange, rng);
+    const T y = SampleCoordinate<T>(yRange, rng);
+    const mp::BasicVector2<T> pos{x, y};
+    bFoundPos = true;
+    for (const auto& player : players) {
+      if (IsColliding(pos, mp::BasicPuck<T>::baseRadius,
+                      player.transform.pos, player.transform.radius)) {
+        bFoundPos = false;
+        break;
+      }
+    }
+    newPlayer.transform.pos = pos;
+  }
+}
+
+// Where to put (tick, rank) of a team after a goal: a walk over the slots
+// with a stride coprime to their count, so ranks below it get distinct slots.
+struct SlotOrder {
+  std::size_t start{0};
+  std::size_t stride{1};
+  std::size_t size{1};
+
+  SlotOrder(const std::size_t slotCount, CounterRng& rng)
+      : size(std::max<std::size_t>(slotCount, 1)) {
+    start = rng() % size;
+    if (size > 2) {
+      stride = 1 + rng() % (size - 1);
+      while (std::gcd(stride, size) != 1) ++stride;
+    }
+  }
+
+  [[nodiscard]]
+  std::size_t operator[](const std::size_t rank) const {
+    return (start + rank * stride) % size;
+  }
+};
+
+// Ranges for spawning players and the room's seed. Spawns go to slots
+// precomputed per team half, a hexagonal packing one player diameter apart,
+// so placing a player is O(1) with a fixed bound instead of rejection
+// sampling against everyone. Draws come from the counter streams of (seed,
+// tick, player id) and (seed, tick, team), so nothing is shared between
+// rooms or ticks.
+struct SpawnArea {
+  static constexpr SpawnRange kXRange{
+      ToFloat(mp::WorldState::leftRightLines.x) + mp::Player::baseRadius,
+      ToFloat(mp::WorldState::leftRightLines.y) - mp::Player::baseRadius};
+  static constexpr std::array<SpawnRange, 2> kTeamYRanges{{
+      {ToFloat(mp::WorldState::teamsGoalsY.x) + mp::Player::baseRadius,
+       -0.4f},
+      {0.4f, ToFloat(mp::WorldState::teamsGoalsY.y) - mp::Player::baseRadius},
+  }};
+  // slots a joining player tries before settling anywhere in its half
+  static constexpr std::size_t kJoinAttempts = 8;
+  // team streams sit above every player id
+  static constexpr std::uint64_t kTeamStream = std::uint64_t{1} << 32;
+  std::uint64_t seed;
+
+  explicit SpawnArea(const std::uint64_t seed) : seed(seed) {}
+
+  template <typename T>
+  [[nodiscard]]
+  static const std::vector<mp::BasicVector2<T>>& Slots(
+      const std::uint32_t teamId) {
+    static const std::array<std::vector<mp::BasicVector2<T>>, 2> slots{
+        MakeSlots<T>(kTeamYRanges[0]), MakeSlots<T>(kTeamYRanges[1])};
+    return slots[teamId];
+  }
+
+  // A joining player: a free slot of its half if one of a few draws finds
+  // one, else any point of the half for the collisions to sort out.
+  template <typename T>
+  void ResetPlayerPos(mp::BasicPlayer<T>& player,
+                      const std::vector<mp::BasicPlayer<T>>& players,
+                      const std::uint64_t tick) const {
+    CounterRng rng(seed, tick, player.id);
+    const std::vector<mp::BasicVector2<T>>& slots = Slots<T>(player.teamId);
+    player.transform.velocity = {0.0f, 0.0f};
+    player.transform.restTicks = 0;
+    for (std::size_t attempt = 0; attempt < kJoinAttempts; ++attempt) {
+      const mp::BasicVector2<T> pos = slots[rng() % slots.size()];
+      const bool bIsFree = std::ranges::none_of(players, [&](const auto& o) {
+        return IsColliding(pos, player.transform.radius, o.transform.pos,
+                           o.transform.radius);
+      });
+      if (bIsFree) {
+        player.transform.pos = pos;
+        return;
+      }
+    }
+    player.transform.pos = SamplePoint<T>(player.teamId, rng);
+  }
+
+  // After a goal: every team walks its slots in an order drawn for the
+  // tick, one slot per player in vector order. Players beyond the slot
+  // count land anywhere in their half.
+  template <typename T>
+  void ResetTeams(std::vector<mp::BasicPlayer<T>>& players,
+                  const std::uint64_t tick) const {
+    std::array<CounterRng, 2> teamRngs{CounterRng(seed, tick, kTeamStream),
+                                       CounterRng(seed, tick, kTeamStream + 1)};
+    const std::array<SlotOrder, 2> orders{
+        SlotOrder(Slots<T>(0).size(), teamRngs[0]),
+        SlotOrder(Slots<T>(1).size(), teamRngs[1])};
+    std::array<std::size_t, 2> ranks{};
+    for (mp::BasicPlayer<T>& player : players) {
+      const std::vector<mp::BasicVector2<T>>& slots = Slots<T>(player.teamId);
+      const std::size_t rank = ranks[player.teamId]++;
+      player.transform.velocity = {0.0f, 0.0f};
+      player.transform.restTicks = 0;
+      if (rank < slots.size()) {
+        player.transform.pos = slots[orders[player.teamId][rank]];
+      } else {
+        CounterRng rng(seed, tick, player.id);
+        player.transform.pos = SamplePoint<T>(player.teamId, rng);
+      }
+    }
+  }
+
+ private:
+  template <typename T>
+  static std::vector<mp::BasicVector2<T>> MakeSlots(const SpawnRange& yRange) {
+    constexpr T kSpacing = 2 * mp::Player::baseRadius;
+    const T rowStep = kSpacing * 0.8660254f;
+    std::vector<mp::BasicVector2<T>> slots;
+    int row = 0;
+    for (T y = yRange.low; y <= T(yRange.high); y += rowStep, ++row) {
+      const T shift = row % 2 == 1 ? kSpacing / 2 : T(0);
+      for (T x = T(kXRange.low) + shift; x <= T(kXRange.high); x += kSpacing) {
+        slots.push_back({x, y});
+      }
+    }
+    return slots;
+  }
+
+  template <typename T>
+  static mp::BasicVector2<T> SamplePoint(const std::uint32_t teamId,
+                                         CounterRng& rng) {
+    const T x = SampleCoordinate<T>(kXRange, rng);
+    const T y = SampleCoordinate<T>(kTeamYRanges[teamId], rng);
+    return {x, y};
+  }
+};
+
+namespace detail {
+
+// More colors than any contact graph of equal circles needs; contacts that
+// find all of them taken go to one more color, solved serially.
+constexpr std::size_t kMaxContactColors = 64;
+
+template <typename T>
+struct BasicContact {
+  std::uint32_t a;
+  std::uint32_t b;
+  mp::BasicVector2<T> normal;  // from a to b
+  T inverseMassA;
+  T inverseMassB;
+  T normalMass;
+  T targetSpeed;  // separating speed the bounce ends at
+  T impulse;  // accumulated over the passes, never pulling
+};
+
+// The contact of bodies `a` and `b` if they touch and are not both asleep.
+template <typename T>
+bool MakeContact(BasicContact<T>& contact,
+                 const mp::BasicMoveableObject<T>& lhs,
+                 const mp::BasicMoveableObject<T>& rhs, const std::uint32_t a,
+                 const std::uint32_t b) {
+  if (IsAsleep(lhs) && IsAsleep(rhs)) return false;
+  if (!IsColliding(lhs.pos, lhs.radius, rhs.pos, rhs.radius)) return false;
+  const mp::BasicVector2<T> delta = rhs.pos - lhs.pos;
+  const T distance = delta.Length();
+  // bodies on the same spot part along x
+  const mp::BasicVector2<T> normal =
+      distance > 0 ? delta / distance : mp::BasicVector2<T>{1.0f, 0.0f};
+  const T inverseMassA = 1 / lhs.mass;
+  const T inverseMassB = 1 / rhs.mass;
+  const T speed = (rhs.velocity - lhs.velocity).DotProduct(normal);
+  contact = {.a = a,
+             .b = b,
+             .normal = normal,
+             .inverseMassA = inverseMassA,
+             .inverseMassB = inverseMassB,
+             .normalMass = 1 / (inverseMassA + inverseMassB),
+             .targetSpeed = speed < 0 ? -kRestitution * speed : T(0),
+             .impulse = 0};
+  return true;
+}
+
+template <typename T>
+void SolveContactVelocity(BasicContact<T>& contact,
+                          mp::BasicMoveableObject<T>& lhs,
+                          mp::BasicMoveableObject<T>& rhs) {
+  const T speed = (rhs.velocity - lhs.velocity).DotProduct(contact.normal);
+  const T impulse = std::max(
+      contact.impulse + (contact.targetSpeed - speed) * contact.normalMass,
+      T(0));
+  const T change = impulse - contact.impulse;
+  contact.impulse = impulse;
+  lhs.velocity -= contact.normal * (change * contact.inverseMassA);
+  rhs.velocity += contact.normal * (change * contact.inverseMassB);
+}
+
+// Pushes out the penetration beyond the slop and wakes both bodies if the
+// contact changed them at all.
+template <typename T>
+void CorrectContactPosition(const BasicContact<T>& contact,
+                            mp::BasicMoveableObject<T>& lhs,
+                            mp::BasicMoveableObject<T>& rhs) {
+  constexpr float kPenetrationSlop = .001f;
+  constexpr float kPenetrationCorrection = .8f;
+  const mp::BasicVector2<T> delta = rhs.pos - lhs.pos;
+  const T distance = delta.Length();
+  const T depth = lhs.radius + rhs.radius - distance - kPenetrationSlop;
+  const bool bIsPushed = depth > 0;
+  if (bIsPushed) {
+    const mp::BasicVector2<T> normal =
+        distance > 0 ? delta / distance : contact.normal;
+    const T push = depth * kPenetrationCorrection * contact.normalMass;
+    lhs.pos -= normal * (push * contact.inverseMassA);
+    rhs.pos += normal * (push * contact.inverseMassB);
+  }
+  if (bIsPushed || contact.impulse > 0) {
+    lhs.restTicks = 0;
+    rhs.restTicks = 0;
+  }
+}
+
+// Greedy, in contact order: each contact takes the lowest color neither of
+// its bodies has yet. Writes the contacts grouped by color to `ordered`
+// and where each color starts to `colorStarts`, one past the last color
+// included; returns the color count.
+template <typename T>
+std::size_t ColorContacts(
+    const std::span<const BasicContact<T>> contacts,
+    const std::span<std::uint64_t> bodyColors,
+    const std::span<std::uint8_t> colorOf,
+    const std::span<BasicContact<T>> ordered,
+    std::array<std::size_t, kMaxContactColors + 2>& colorStarts) {
+  std::ranges::fill(bodyColors, 0);
+  std::array<std::size_t, kMaxContactColors + 1> counts{};
+  std::size_t colors = 0;
+  for (std::size_t i = 0; i < contacts.size(); ++i) {
+    const BasicContact<T>& contact = contacts[i];
+    const std::uint64_t taken = bodyColors[contact.a] | bodyColors[contact.b];
+    const std::size_t color =
+        ~taken == 0 ? kMaxContactColors : std::countr_zero(~taken);
+    if (color < kMaxContactColors) {
+      bodyColors[contact.a] |= std::uint64_t{1} << color;
+      bodyColors[contact.b] |= std::uint64_t{1} << color;
+    }
+    colorOf[i] = static_cast<std::uint8_t>(color);
+    ++counts[color];
+    colors = std::max(colors, color + 1);
+  }
+  colorStarts[0] = 0;
+  for (std::size_t color = 0; color < colors; ++color) {
+    colorStarts[color + 1] = colorStarts[color] + counts[color];
+  }
+  std::array<std::size_t, kMaxContactColors + 1> next{};
+  std::copy_n(colorStarts.begin(), colors, next.begin());
+  for (std::size_t i = 0; i < contacts.size(); ++i) {
+    ordered[next[colorOf[i]]++] = contacts[i];
+  }
+  return colors;
+}
+
+}  // namespace detail
+
+// The contacts of a tick, solved together rather than pair by pair in loop
+// order. They are gathered from the positions the tick starts with and
+// colored so that no body is in two contacts of one color; then come a few
+// velocity passes and one penetration pass, color by color. Contacts of a
+// color touch disjoint bodies, so they are split across threads in any way
+// and a tick comes out the same whatever the thread count. Buffers are kept
+// between ticks.
+//
+// Rooms of 2, 4 and 10 players, the 1v1, 2v2 and 5v5 modes, go through
+// SolveContactsFixed instead, which gives the same result.
+template <typename T>
+class BasicContactSolver {
+ public:
+  BasicContactSolver(const BasicContactSolver&) = delete;
+  BasicContactSolver& operator=(const BasicContactSolver&) = delete;
+
+  static constexpr int kVelocityPasses = 4;
+  // below these, waking the helpers costs more than it saves
+  static constexpr std::size_t kMinParallelContacts = 64;
+  static constexpr std::size_t kMinParallelBodies = 64;
+  // contact room per body kept up front, so that a room does not allocate
+  // every time it sets a new contact record; circles of one size touch at
+  // most six others, three contacts each when counted once
+  static constexpr std::size_t kReservedContactsPerBody = 4;
+
+  explicit BasicContactSolver(
+      const std::size_t threads = 1,
+      const std::size_t minParallelContacts = kMinParallelContacts)
+      : team_(std::max<std::size_t>(threads, 1)),
+        minParallelContacts_(minParallelContacts),
+        gathered_(team_.Size()) {}
+
+  // Applies the tick's collision impulses and penetration pushes to the
+  // players and the puck, waking the bodies it changes.
+  void Solve(mp::BasicWorldState<T>& world);
+
+  // Off: every room takes the generic path, for comparing against it.
+  void SetFixedKernels(const bool bIsEnabled) {
+    bUsesFixedKernels_ = bIsEnabled;
+  }
+
+  // of the last tick on the generic path
+  [[nodiscard]]
+  std::size_t ContactCount() const {
+    return contacts_.size();
+  }
+
+  [[nodiscard]]
+  std::size_t ColorCount() const {
+    return colorCount_;
+  }
+
+ private:
+  using Contact = detail::BasicContact<T>;
+
+  void Reserve(const std::size_t contacts) {
+    if (contacts_.capacity() >= contacts) return;
+    for (std::vector<Contact>& share : gathered_) share.reserve(contacts);
+    contacts_.reserve(contacts);
+    colorOf_.reserve(contacts);
+    ordered_.reserve(contacts);
+  }
+
+  void Gather() {
+    const std::size_t shares =
+        bodies_.size() >= kMinParallelBodies ? team_.Size() : 1;
+    // share k takes rows k, k + shares, ..., evening out the triangle
+    auto gather = [this, shares](const std::size_t begin,
+                                 const std::size_t end) {
+      for (std::size_t share = begin; share < end; ++share) {
+        std::vector<Contact>& out = gathered_[share];
+        out.clear();
+        for (std::size_t a = share; a < bodies_.size(); a += shares) {
+          for (std::size_t b = a + 1; b < bodies_.size(); ++b) {
+            Contact contact;
+            if (detail::MakeContact(contact, *bodies_[a], *bodies_[b],
+                                    static_cast<std::uint32_t>(a),
+                                    static_cast<std::uint32_t>(b))) {
+              out.push_back(contact);
+            }
+          }
+        }
+      }
+    };
+    if (shares == 1) {
+      gather(0, 1);
+    } else {
+      team_.Run(shares, gather);
+    }
+    contacts_.clear();
+    for (std::size_t share = 0; share < shares; ++share) {
+      contacts_.insert(contacts_.end(), gathered_[share].begin(),
+                       gathered_[share].end());
+    }
+    if (shares > 1) {
+      std::ranges::sort(contacts_, {}, [](const Contact& contact) {
+        return std::pair(contact.a, contact.b);
+      });
+    }
+  }
+
+  template <typename Solve>
+  void ForEachContact(const Solve& solve) {
+    for (std::size_t color = 0; color < colorCount_; ++color) {
+      Contact* const first = ordered_.data() + colorStarts_[color];
+      const std::size_t count = colorStarts_[color + 1] - colorStarts_[color];
+      auto run = [first, &solve](const std::size_t begin,
+                                 const std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) solve(first[i]);
+      };
+      if (color < detail::kMaxContactColors &&
+          count >= minParallelContacts_) {
+        team_.Run(count, run);
+      } else {
+        run(0, count);
+      }
+    }
+  }
+
+  WorkerTeam team_;
+  std::size_t minParallelContacts_;
+  bool bUsesFixedKernels_{true};
+  std::vector<mp::BasicMoveableObject<T>*> bodies_;
+  std::vector<std::vector<Contact>> gathered_;  // per share
+  std::vector<Contact> contacts_;
+  std::vector<std::uint64_t> bodyColors_;  // bit per color taken
+  std::vector<std::uint8_t> colorOf_;
+  std::vector<Contact> ordered_;  // by color
+  std::array<std::size_t, detail::kMaxContactColors + 2> colorStarts_{};
+  std::size_t colorCount_{0};
+};
+
+// The contact solve of BasicContactSolver for a room of exactly kPlayers,
+// on std::array state. The near test runs branch-free over every ordered
+// pair of bodies with compile-time bounds, one contiguous row per body, so
+// the compiler unrolls and vectorizes it; only the pairs it lets through
+// take the exact test. Contacts come out and are solved in the same order
+// as on the generic path, so a room steps bit-identically either way.
+template <std::size_t kPlayers, typename T>
+void SolveContactsFixed(mp::BasicWorldState<T>& world) {
+  constexpr std::size_t kBodies = kPlayers + 1;
+  constexpr std::size_t kMaxContacts = kBodies * (kBodies - 1) / 2;
+  std::array<mp::BasicMoveableObject<T>*, kBodies> bodies;
+  for (std::size_t i = 0; i < kPlayers; ++i) {
+    bodies[i] = &world.players[i].transform;
+  }
+  bodies[kPlayers] = &world.puck.transform;
+  const auto body = [&bodies](const std::size_t i) -> auto& {
+    return *bodies[i];
+  };
+
+  std::array<detail::BasicContact<T>, kMaxContacts> contacts;
+  std::size_t contactCount = 0;
+  const auto addContact = [&](const std::uint32_t a, const std::uint32_t b) {
+    if (detail::MakeContact(contacts[contactCount], body(a), body(b), a, b)) {
+      ++contactCount;
+    }
+  };
+  if constexpr (std::is_floating_point_v<T>) {
+    // Squared distance against squared reach from a body to every other at
+    // once, rows padded to whole vectors with bodies far off the rink. The
+    // bound is widened a little, so that it never drops a pair the exact
+    // test, which compares lengths, would keep.
+    constexpr std::size_t kLanes = 4;
+    constexpr std::size_t kRow = (kBodies + kLanes - 1) / kLanes * kLanes;
+    std::array<T, kRow> xs;
+    std::array<T, kRow> ys;
+    std::array<T, kRow> radii;
+    for (std::size_t i = 0; i < kRow; ++i) {
+      xs[i] = i < kBodies ? body(i).pos.x : T(1000 + i);
+      ys[i] = i < kBodies ? body(i).pos.y : T(1000);
+      radii[i] = i < kBodies ? body(i).radius : T(0);
+    }
+    for (std::uint32_t a = 0; a + 1 < kBodies; ++a) {
+      std::array<std::int32_t, kRow> bIsNear;
+      for (std::size_t b = 0; b < kRow; ++b) {
+        const T dx = xs[a] - xs[b];
+        const T dy = ys[a] - ys[b];
+        const T reach = radii[a] + radii[b];
+        bIsNear[b] = dx * dx + dy * dy <= reach * reach * 1.001f;
+      }
+      for (std::uint32_t b = a + 1; b < kBodies; ++b) {
+        if (bIsNear[b]) addContact(a, b);
+      }
+    }
+  } else {
+    // the exact test is integer math already, nothing to filter
+    for (std::uint32_t a = 0; a + 1 < kBodies; ++a) {
+      for (std::uint32_t b = a + 1; b < kBodies; ++b) addContact(a, b);
+    }
+  }
+  if (contactCount == 0) return;
+
+  std::array<std::uint64_t, kBodies> bodyColors;
+  std::array<std::uint8_t, kMaxContacts> colorOf;
+  std::array<detail::BasicContact<T>, kMaxContacts> ordered;
+  std::array<std::size_t, detail::kMaxContactColors + 2> colorStarts;
+  const std::size_t colors = detail::ColorContacts<T>(
+      std::span(contacts.data(), contactCount), bodyColors, colorOf,
+      ordered, colorStarts);
+  const auto forEachContact = [&](const auto& solve) {
+    for (std::size_t i = 0; i < colorStarts[colors]; ++i) solve(ordered[i]);
+  };
+  for (int pass = 0; pass < BasicContactSolver<T>::kVelocityPasses; ++pass) {
+    forEachContact([&](detail::BasicContact<T>& contact) {
+      detail::SolveContactVelocity(contact, body(contact.a), body(contact.b));
+    });
+  }
+  forEachContact([&](const detail::BasicContact<T>& contact) {
+    detail::CorrectContactPosition(contact, body(contact.a),
+                                   body(contact.b));
+  });
+}
+
+template <typename T>
+void BasicContactSolver<T>::Solve(mp::BasicWorldState<T>& world) {
+  if (bUsesFixedKernels_) {
+    contacts_.clear();
+    colorCount_ = 0;
+    switch (world.players.size()) {
+      case 2:
+        return SolveContactsFixed<2>(world);
+      case 4:
+        return SolveContactsFixed<4>(world);
+      case 10:
+        return SolveContactsFixed<10>(world);
+      default:
+        break;
+    }
+  }
+  bodies_.clear();
+  for (auto& player : world.players) bodies_.push_back(&player.transform);
+  bodies_.push_back(&world.puck.transform);
+  Reserve(bodies_.size() * kReservedContactsPerBody);
+  Gather();
+  if (contacts_.empty()) {
+    colorCount_ = 0;
+    return;
+  }
+  bodyColors_.resize(bodies_.size());
+  colorOf_.resize(contacts_.size());
+  ordered_.resize(contacts_.size());
+  colorCount_ = detail::ColorContacts<T>(contacts_, bodyColors_, colorOf_,
+                                         ordered_, colorStarts_);
+  for (int pass = 0; pass < kVelocityPasses; ++pass) {
+    ForEachContact([this](Contact& contact) {
+      detail::SolveContactVelocity(contact, *bodies_[contact.a],
+                                   *bodies_[contact.b]);
+    });
+  }
+  ForEachContact([this](const Contact& contact) {
+    detail::CorrectContactPosition(contact, *bodies_[contact.a],
+                                   *bodies_[contact.b]);
+  });
+}
+
+using ContactSolver = BasicContactSolver<Real>;
+
+// Advances the world by one fixed step; `tick` numbers the state it makes.
+template <typename T>
+void StepWorld(mp::BasicWorldState<T>& worldState, const SpawnArea& spawnArea,
+               const std::uint64_t tick, BasicContactSolver<T>& contacts,
+               const mp::BasicRinkField<T>& rink = DefaultRinkField<T>()) {
+  contacts.Solve(worldState);
+  for (auto& player : worldState.players) {
+    MoveBody(player.transform, rink);
+  }
+
+  // check for the goal
+  bool bIsGoal = false;
+  if (worldState.puck.transform.pos.y <
+      mp::BasicWorldState<T>::teamsGoalsY.x) {
+    worldState.goals[1]++;
+    bIsGoal = true;
+  } else if (worldState.puck.transform.pos.y >
+             mp::BasicWorldState<T>::teamsGoalsY.y) {
+    worldState.goals[0]++;
+    bIsGoal = true;
+  }
+  if (bIsGoal) {
+    worldState.puck.transform.pos = {0.0f, 0.0f};
+    worldState.puck.transform.velocity = {0.0f, 0.0f};
+    worldState.puck.transform.restTicks = 0;
+    spawnArea.ResetTeams(worldState.players, tick);
+  }
+
+  MoveBody(worldState.puck.transform, rink);
+}
+
+}  // namespace mp
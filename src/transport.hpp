@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace mp {
+
+using PeerId = std::uint32_t;
+inline constexpr PeerId kInvalidPeerId = ~0u;
+
+enum PacketFlags : std::uint32_t {
+  kPacketUnreliable = 0,
+  kPacketReliable = 1u << 0,
+  kPacketUnsequenced = 1u << 1,
+};
+
+enum class TransportEventType : std::uint8_t {
+  Connect,
+  Disconnect,
+  Receive,
+};
+
+struct TransportEvent {
+  TransportEventType type{TransportEventType::Receive};
+  PeerId peer{kInvalidPeerId};
+  std::uint8_t channel{0};
+  // Receive only: the PacketFlags it was sent with, and its payload, valid
+  // until the next Poll on the same transport.
+  std::uint32_t flags{0};
+  std::span<const std::uint8_t> data;
+};
+
+// Everything the game needs from the network. Peers are identified by small
+// integers that stay valid until their Disconnect event.
+class Transport {
+ public:
+  virtual ~Transport() = default;
+
+  // Starts connecting; a Connect event for the returned peer follows once the
+  // other side accepted. Returns kInvalidPeerId if no attempt could start.
+  virtual PeerId Connect(const std::string& host, std::uint16_t port,
+                         std::size_t channelCount) = 0;
+
+  virtual void Send(PeerId peer, std::span<const std::uint8_t> data,
+                    std::uint8_t channel, std::uint32_t flags) = 0;
+
+  virtual void Broadcast(std::span<const std::uint8_t> data,
+                         std::uint8_t channel, std::uint32_t flags) = 0;
+
+  // Fetches the next event, waiting up to `timeoutMs` if none is pending.
+  // Also drives retransmits and timeouts, so call it regularly.
+  virtual bool Poll(TransportEvent& event, std::uint32_t timeoutMs = 0) = 0;
+
+  // Pushes queued packets out without waiting for the next Poll.
+  virtual void Flush() = 0;
+
+  // Graceful: a Disconnect event follows on both sides.
+  virtual void Disconnect(PeerId peer) = 0;
+
+  // Drops the peer at once; only the other side sees a Disconnect.
+  virtual void Reset(PeerId peer) = 0;
+};
+
+}  // namespace mp
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "float_env.hpp"
+
+namespace mp {
+
+// The calling thread plus `threads - 1` helpers that split loops between
+// them. A loop over [0, count) is cut into one contiguous share per thread
+// and Run returns once every share is done; nothing is allocated per loop.
+// Helpers sleep between loops, so a team costs nothing while unused. They
+// flush denormals as the thread calling Run does, so a loop's shares round
+// alike whichever thread takes them.
+class WorkerTeam {
+ public:
+  WorkerTeam(const WorkerTeam&) = delete;
+  WorkerTeam& operator=(const WorkerTeam&) = delete;
+
+  explicit WorkerTeam(const std::size_t threads)
+      : bFlushesDenormals_(IsDenormalFlushEnabled()) {
+    for (std::size_t i = 1; i < threads; ++i) {
+      helpers_.emplace_back([this, i] { HelperLoop(i); });
+    }
+  }
+
+  ~WorkerTeam() {
+    {
+      std::lock_guard lock(mutex_);
+      bIsStopping_ = true;
+      ++generation_;
+    }
+    wake_.notify_all();
+    helpers_.clear();
+  }
+
+  [[nodiscard]]
+  std::size_t Size() const {
+    return helpers_.size() + 1;
+  }
+
+  // Calls body(begin, end) once per thread with its share of [0, count).
+  template <typename Body>
+  void Run(const std::size_t count, Body& body) {
+    if (helpers_.empty()) {
+      body(std::size_t{0}, count);
+      return;
+    }
+    {
+      std::lock_guard lock(mutex_);
+      bFlushesDenormals_ = IsDenormalFlushEnabled();
+      context_ = &body;
+      call_ = [](void* context, const std::size_t begin,
+                 const std::size_t end) {
+        (*static_cast<Body*>(context))(begin, end);
+      };
+      count_ = count;
+      pending_.store(helpers_.size(), std::memory_order_relaxed);
+      ++generation_;
+    }
+    wake_.notify_all();
+    body(std::size_t{0}, ShareEnd(0, count));
+    for (std::size_t left = pending_.load(std::memory_order_acquire);
+         left != 0; left = pending_.load(std::memory_order_acquire)) {
+      pending_.wait(left, std::memory_order_acquire);
+    }
+  }
+
+ private:
+  [[nodiscard]]
+  std::size_t ShareEnd(const std::size_t share, const std::size_t count) const {
+    return count * (share + 1) / Size();
+  }
+
+  void HelperLoop(const std::size_t share) {
+    std::uint64_t seen = 0;
+    bool bFlushes = false;
+    {
+      std::lock_guard lock(mutex_);
+      bFlushes = bFlushesDenormals_;
+    }
+    SetDenormalFlush(bFlushes);
+    while (true) {
+      void* context = nullptr;
+      void (*call)(void*, std::size_t, std::size_t) = nullptr;
+      std::size_t count = 0;
+      bool bCallerFlushes = false;
+      {
+        std::unique_lock lock(mutex_);
+        wake_.wait(lock, [&] { return generation_ != seen; });
+        if (bIsStopping_) return;
+        seen = generation_;
+        context = context_;
+        call = call_;
+        count = count_;
+        bCallerFlushes = bFlushesDenormals_;
+      }
+      // the caller may have switched since the team was made
+      if (bCallerFlushes != bFlushes) {
+        bFlushes = bCallerFlushes;
+        SetDenormalFlush(bFlushes);
+      }
+      call(context, ShareEnd(share - 1, count), ShareEnd(share, count));
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pending_.notify_one();
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::uint64_t generation_{0};
+  bool bIsStopping_{false};
+  bool bFlushesDenormals_;
+  void* context_{nullptr};
+  void (*call_)(void*, std::size_t, std::size_t){nullptr};
+  std::size_t count_{0};
+  std::atomic<std::size_t> pending_{0};
+  std::vector<std::jthread> helpers_;  // last: they stop before the rest
+};
+
+}  // namespace mp
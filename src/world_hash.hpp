@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "game_data.hpp"
+#include "net_common.hpp"
+
+namespace mp {
+
+// Per-tick fingerprint of the simulation, to find the first tick on which a
+// client's or a replay's world stopped matching the server's. Not
+// cryptographic: it only has to tell two honest worlds apart.
+//
+// The canonical layout is little-endian 32-bit words: the player count, both
+// goals and the puck (pos, velocity, radius, mass, restTicks), then every
+// player in vector order (id, teamId, pos, velocity, radius, mass,
+// restTicks, lastInputSequence). Scalars contribute their bits: a float as
+// is, Fixed its raw value. The header is chained into the seed the players'
+// bytes are hashed with; on little-endian hosts those bytes are the vector
+// itself.
+
+namespace detail {
+
+inline constexpr std::uint64_t kHashSeed = 0x6D702D776F726C64ull;
+inline constexpr std::uint64_t kHashMultiplier = 0x9E3779B97F4A7C15ull;
+
+[[nodiscard]]
+inline std::uint64_t HashFinalize(std::uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+[[nodiscard]]
+inline std::uint64_t HashLane(std::uint64_t lane, const std::uint64_t word) {
+  lane = (lane ^ word) * kHashMultiplier;
+  return lane ^ (lane >> 29);
+}
+
+[[nodiscard]]
+inline std::uint64_t LoadLittleEndian64(const std::uint8_t* data) {
+  std::uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = std::byteswap(word);
+  }
+  return word;
+}
+
+// Four independent lanes over 32-byte blocks, so a 5v5 world costs a few
+// dozen cycles rather than a multiply chain per word. The rotate brings the
+// high bits, which a multiply only carries out of the word, down to where
+// the next multiply spreads them; without it two sign flips in one lane
+// cancel.
+[[nodiscard]]
+inline std::uint64_t HashBytes(const std::uint8_t* data, std::size_t size,
+                               const std::uint64_t seed) {
+  const std::uint64_t length = size;
+  std::array<std::uint64_t, 4> lanes{seed, seed + kHashMultiplier,
+                                     seed ^ 0x243F6A8885A308D3ull,
+                                     seed - kHashMultiplier};
+  for (; size >= 32; data += 32, size -= 32) {
+    for (std::size_t i = 0; i < lanes.size(); ++i) {
+      lanes[i] =
+          std::rotl(lanes[i] ^ LoadLittleEndian64(data + 8 * i), 31) *
+          kHashMultiplier;
+    }
+  }
+  std::uint64_t hash = HashLane(seed, length);
+  for (const std::uint64_t lane : lanes) hash = HashLane(hash, lane);
+  for (; size >= 8; data += 8, size -= 8) {
+    hash = HashLane(hash, LoadLittleEndian64(data));
+  }
+  if (size > 0) {
+    std::array<std::uint8_t, 8> tail{};
+    std::memcpy(tail.data(), data, size);
+    hash = HashLane(hash, LoadLittleEndian64(tail.data()));
+  }
+  return HashFinalize(hash);
+}
+
+[[nodiscard]]
+constexpr std::uint32_t CanonicalWord(const std::uint32_t value) {
+  return value;
+}
+
+[[nodiscard]]
+constexpr std::uint32_t CanonicalWord(const float value) {
+  return std::bit_cast<std::uint32_t>(value);
+}
+
+[[nodiscard]]
+constexpr std::uint32_t CanonicalWord(const Fixed value) {
+  return static_cast<std::uint32_t>(value.RawValue());
+}
+
+template <typename Word>
+void StoreLittleEndian(std::uint8_t*& out, const Word value) {
+  const std::uint32_t word = CanonicalWord(value);
+  for (int shift = 0; shift < 32; shift += 8) {
+    *out++ = static_cast<std::uint8_t>(word >> shift);
+  }
+}
+
+[[nodiscard]]
+constexpr std::uint64_t PairWords(const std::uint32_t low,
+                                  const std::uint32_t high) {
+  return std::uint64_t{low} | std::uint64_t{high} << 32;
+}
+
+// Whether the players vector already is the canonical layout in memory.
+template <typename T>
+inline constexpr bool kHasCanonicalPlayerMemory =
+    std::endian::native == std::endian::little && sizeof(T) == 4 &&
+    std::is_trivially_copyable_v<BasicPlayer<T>> &&
+    sizeof(BasicPlayer<T>) == 40 && offsetof(BasicPlayer<T>, transform) == 8 &&
+    offsetof(BasicPlayer<T>, lastInputSequence) == 36;
+
+}  // namespace detail
+
+template <typename T>
+[[nodiscard]]
+std::uint64_t HashWorld(const BasicWorldState<T>& world) {
+  using detail::CanonicalWord;
+  using detail::PairWords;
+  const auto& puck = world.puck.transform;
+  std::uint64_t seed = detail::kHashSeed;
+  for (const std::uint64_t word :
+       {PairWords(static_cast<std::uint32_t>(world.players.size()),
+                  world.goals[0]),
+        PairWords(world.goals[1], CanonicalWord(puck.pos.x)),
+        PairWords(CanonicalWord(puck.pos.y), CanonicalWord(puck.velocity.x)),
+        PairWords(CanonicalWord(puck.velocity.y), CanonicalWord(puck.radius)),
+        PairWords(CanonicalWord(puck.mass), puck.restTicks)}) {
+    seed = detail::HashLane(seed, word);
+  }
+
+  if constexpr (detail::kHasCanonicalPlayerMemory<T>) {
+    return detail::HashBytes(
+        reinterpret_cast<const std::uint8_t*>(world.players.data()),
+        world.players.size() * sizeof(BasicPlayer<T>), seed);
+  } else {
+    std::vector<std::uint8_t> bytes(world.players.size() * 40);
+    std::uint8_t* out = bytes.data();
+    for (const BasicPlayer<T>& player : world.players) {
+      detail::StoreLittleEndian(out, player.id);
+      detail::StoreLittleEndian(out, player.teamId);
+      detail::StoreLittleEndian(out, player.transform.pos.x);
+      detail::StoreLittleEndian(out, player.transform.pos.y);
+      detail::StoreLittleEndian(out, player.transform.velocity.x);
+      detail::StoreLittleEndian(out, player.transform.velocity.y);
+      detail::StoreLittleEndian(out, player.transform.radius);
+      detail::StoreLittleEndian(out, player.transform.mass);
+      detail::StoreLittleEndian(out, player.transform.restTicks);
+      detail::StoreLittleEndian(out, player.lastInputSequence);
+    }
+    return detail::HashBytes(bytes.data(), bytes.size(), seed);
+  }
+}
+
+// The first field, in canonical order, whose bits differ between two worlds.
+struct WorldDifference {
+  std::string field;
+  std::string expected;
+  std::string actual;
+};
+
+namespace detail {
+
+inline std::string DescribeWord(const std::uint32_t value) {
+  return std::to_string(value);
+}
+
+template <typename T>
+  requires(std::is_same_v<T, float> || std::is_same_v<T, Fixed>)
+std::string DescribeWord(const T value) {
+  std::ostringstream out;
+  out << std::setprecision(9) << ToFloat(value) << " (0x" << std::hex
+      << std::setw(8) << std::setfill('0') << CanonicalWord(value) << ")";
+  return out.str();
+}
+
+class DifferenceFinder {
+ public:
+  template <typename Word>
+  void Compare(const std::string& field, const Word expected,
+               const Word actual) {
+    if (difference_ || CanonicalWord(expected) == CanonicalWord(actual)) return;
+    difference_ =
+        WorldDifference{field, DescribeWord(expected), DescribeWord(actual)};
+  }
+
+  template <typename T>
+  void Compare(const std::string& field, const BasicMoveableObject<T>& expected,
+               const BasicMoveableObject<T>& actual) {
+    Compare(field + ".pos.x", expected.pos.x, actual.pos.x);
+    Compare(field + ".pos.y", expected.pos.y, actual.pos.y);
+    Compare(field + ".velocity.x", expected.velocity.x, actual.velocity.x);
+    Compare(field + ".velocity.y", expected.velocity.y, actual.velocity.y);
+    Compare(field + ".radius", expected.radius, actual.radius);
+    Compare(field + ".mass", expected.mass, actual.mass);
+    Compare(field + ".restTicks", expected.restTicks, actual.restTicks);
+  }
+
+  [[nodiscard]]
+  bool HasDifference() const {
+    return difference_.has_value();
+  }
+
+  [[nodiscard]]
+  std::optional<WorldDifference> Take() {
+    return std::move(difference_);
+  }
+
+ private:
+  std::optional<WorldDifference> difference_;
+};
+
+}  // namespace detail
+
+template <typename T>
+[[nodiscard]]
+std::optional<WorldDifference> FindWorldDifference(
+    const BasicWorldState<T>& expected, const BasicWorldState<T>& actual) {
+  detail::DifferenceFinder finder;
+  finder.Compare("players.size",
+                 static_cast<std::uint32_t>(expected.players.size()),
+                 static_cast<std::uint32_t>(actual.players.size()));
+  finder.Compare("goals[0]", expected.goals[0], actual.goals[0]);
+  finder.Compare("goals[1]", expected.goals[1], actual.goals[1]);
+  finder.Compare("puck.transform", expected.puck.transform,
+                 actual.puck.transform);
+  const std::size_t count =
+      std::min(expected.players.size(), actual.players.size());
+  for (std::size_t i = 0; i < count && !finder.HasDifference(); ++i) {
+    const BasicPlayer<T>& lhs = expected.players[i];
+    const BasicPlayer<T>& rhs = actual.players[i];
+    const std::string field = "players[" + std::to_string(i) + "]";
+    finder.Compare(field + ".id", lhs.id, rhs.id);
+    finder.Compare(field + ".teamId", lhs.teamId, rhs.teamId);
+    finder.Compare(field + ".transform", lhs.transform, rhs.transform);
+    finder.Compare(field + ".lastInputSequence", lhs.lastInputSequence,
+                   rhs.lastInputSequence);
+  }
+  return finder.Take();
+}
+
+// Payload of PacketType::HashedWorldState: a snapshot with the server tick it
+// was taken after and its HashWorld. The rest ticks come along, so the
+// receiver can hash the world it got.
+template <typename T>
+struct BasicHashedWorldState {
+  std::uint64_t tick{0};
+  std::uint64_t hash{0};
+  BasicWorldState<T> world;
+
+  template <typename Archive>
+  void serialize(Archive& ar) {
+    ar(tick, hash, world);
+    SerializeRestTicks(ar, world);
+  }
+};
+
+using HashedWorldState = BasicHashedWorldState<Real>;
+
+// Same bytes as SerializePacket(HashedWorldState, ...), without copying the
+// world into one first.
+[[nodiscard]]
+inline std::string SerializeHashedWorld(const std::uint64_t tick,
+                                        const WorldState& world) {
+  std::stringstream ss;
+  cereal::PortableBinaryOutputArchive ar(ss);
+  ar(PacketType::HashedWorldState);
+  ar(tick, HashWorld(world), world);
+  SerializeRestTicks(ar, world);
+  return ss.str();
+}
+
+struct Desync {
+  std::uint64_t tick{0};
+  std::uint64_t localHash{0};
+  std::uint64_t remoteHash{0};
+  // Only when the local world was kept and the remote one was at hand.
+  std::optional<WorldDifference> difference;
+};
+
+// Remembers the hashes of the last `history` locally simulated ticks and
+// checks the authoritative ones against them as they arrive. With
+// bKeepsWorlds, the debug mode, it also keeps copies of the worlds so that a
+// mismatch can name the first field that differs.
+template <typename T>
+class BasicDesyncDetector final {
+ public:
+  BasicDesyncDetector(const BasicDesyncDetector& other) = delete;
+  BasicDesyncDetector& operator=(const BasicDesyncDetector& other) = delete;
+
+  explicit BasicDesyncDetector(const std::size_t history = 256,
+                               const bool bKeepsWorlds = false)
+      : entries_(std::max<std::size_t>(history, 1)),
+        bKeepsWorlds_(bKeepsWorlds) {}
+
+  void Record(const std::uint64_t tick, const BasicWorldState<T>& world) {
+    Entry& entry = entries_[tick % entries_.size()];
+    entry.tick = tick;
+    entry.hash = HashWorld(world);
+    entry.bIsValid = true;
+    if (bKeepsWorlds_) entry.world = world;
+  }
+
+  // False when `hash` disagrees with the local hash of `tick`. Ticks never
+  // recorded or already out of the history are not judged.
+  bool Check(const std::uint64_t tick, const std::uint64_t hash,
+             const BasicWorldState<T>* remoteWorld = nullptr) {
+    const Entry& entry = entries_[tick % entries_.size()];
+    if (!entry.bIsValid || entry.tick != tick) return true;
+    checks_++;
+    if (entry.hash == hash) return true;
+    // packets may arrive out of order; keep the earliest tick
+    if (!firstDesync_ || tick < firstDesync_->tick) {
+      firstDesync_ = Desync{tick, entry.hash, hash, std::nullopt};
+      if (bKeepsWorlds_ && remoteWorld) {
+        firstDesync_->difference = FindWorldDifference(*remoteWorld,
+                                                       entry.world);
+      }
+    }
+    return false;
+  }
+
+  [[nodiscard]]
+  const std::optional<Desync>& FirstDesync() const {
+    return firstDesync_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t Checks() const {
+    return checks_;
+  }
+
+ private:
+  struct Entry {
+    std::uint64_t tick{0};
+    std::uint64_t hash{0};
+    bool bIsValid{false};
+    BasicWorldState<T> world;
+  };
+
+  std::vector<Entry> entries_;
+  bool bKeepsWorlds_;
+  std::optional<Desync> firstDesync_;
+  std::uint64_t checks_{0};
+};
+
+using DesyncDetector = BasicDesyncDetector<Real>;
+
+}  // namespace mp
@@ -0,0 +1,117 @@
+#include <cstdint>
+#include <iostream>
+
+#include "fixed_point.hpp"
+#include "game_data.hpp"
+#include "world_hash.hpp"
+
+// Checks that HashWorld tells apart worlds that differ in one bit, or in the
+// sign bits of any two player words, for every player count a world can
+// have. Sign flips in pairs are what a lane that never mixes its high bits
+// down cancels out. Exits non-zero on the first collision.
+
+namespace {
+
+constexpr int kPlayerWords = 10;
+
+void Toggle(std::uint32_t& value, const int bit) { value ^= 1u << bit; }
+
+void Toggle(float& value, const int bit) {
+  value = std::bit_cast<float>(std::bit_cast<std::uint32_t>(value) ^
+                               (1u << bit));
+}
+
+void Toggle(mp::Fixed& value, const int bit) {
+  value = mp::Fixed::FromRaw(
+      static_cast<mp::Fixed::Raw>(static_cast<std::uint32_t>(value.RawValue()) ^
+                                  (1u << bit)));
+}
+
+// Flips a bit of the player's `word`th word in the canonical layout.
+template <typename T>
+void FlipBit(mp::BasicPlayer<T>& player, const int word, const int bit) {
+  auto& transform = player.transform;
+  switch (word) {
+    case 0: return Toggle(player.id, bit);
+    case 1: return Toggle(player.teamId, bit);
+    case 2: return Toggle(transform.pos.x, bit);
+    case 3: return Toggle(transform.pos.y, bit);
+    case 4: return Toggle(transform.velocity.x, bit);
+    case 5: return Toggle(transform.velocity.y, bit);
+    case 6: return Toggle(transform.radius, bit);
+    case 7: return Toggle(transform.mass, bit);
+    case 8: return Toggle(transform.restTicks, bit);
+    default: return Toggle(player.lastInputSequence, bit);
+  }
+}
+
+template <typename T>
+[[nodiscard]]
+mp::BasicWorldState<T> MakeWorld(const std::uint32_t playerCount) {
+  mp::BasicWorldState<T> world;
+  world.goals[0] = 2;
+  world.goals[1] = 3;
+  world.puck.transform.pos = {T(0.5f), T(0.25f)};
+  world.puck.transform.velocity = {T(-0.125f), T(0.0625f)};
+  for (std::uint32_t i = 0; i < playerCount; ++i) {
+    mp::BasicPlayer<T>& player = world.players.emplace_back();
+    player.id = i + 1;
+    player.teamId = i % 2;
+    player.transform.pos = {T(0.1f * i), T(0.3f - 0.05f * i)};
+    player.transform.velocity = {T(0.01f * i), T(-0.02f * i)};
+    player.transform.restTicks = i * 7;
+    player.lastInputSequence = 100 + i;
+  }
+  return world;
+}
+
+template <typename T>
+[[nodiscard]]
+bool CheckPlayerCount(const char* scalar, const std::uint32_t playerCount) {
+  const mp::BasicWorldState<T> world = MakeWorld<T>(playerCount);
+  const std::uint64_t hash = mp::HashWorld(world);
+  const int words = static_cast<int>(playerCount) * kPlayerWords;
+  const auto report = [&](const int first, const int second) {
+    std::cout << scalar << ", " << playerCount
+              << " players: collision flipping word " << first;
+    if (second >= 0) std::cout << " and word " << second;
+    std::cout << "\n";
+    return false;
+  };
+
+  for (int word = 0; word < words; ++word) {
+    for (int bit = 0; bit < 32; ++bit) {
+      mp::BasicWorldState<T> changed = world;
+      FlipBit(changed.players[word / kPlayerWords], word % kPlayerWords, bit);
+      if (mp::HashWorld(changed) == hash) return report(word, -1);
+    }
+  }
+  for (int first = 0; first < words; ++first) {
+    for (int second = first + 1; second < words; ++second) {
+      mp::BasicWorldState<T> changed = world;
+      FlipBit(changed.players[first / kPlayerWords], first % kPlayerWords, 31);
+      FlipBit(changed.players[second / kPlayerWords], second % kPlayerWords,
+              31);
+      if (mp::HashWorld(changed) == hash) return report(first, second);
+    }
+  }
+  return true;
+}
+
+template <typename T>
+[[nodiscard]]
+bool Check(const char* scalar) {
+  for (std::uint32_t count = 1; count <= mp::BasicWorldState<T>::maxPlayers;
+       ++count) {
+    if (!CheckPlayerCount<T>(scalar, count)) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  if (!Check<float>("float") || !Check<mp::Fixed>("fixed")) return 1;
+  std::cout << "no collisions\n";
+  return 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "flat_world.hpp"
+
+namespace mp {
+
+// How far back a room keeps its worlds unless told otherwise.
+constexpr std::chrono::milliseconds kWorldHistoryDepth{500};
+
+// The worlds of a room's most recent ticks, one flat copy per tick in a ring
+// sized at construction, so recording a tick never allocates. Tick t lives
+// in slot t % Capacity(); a slot remembers its tick, so a lookup is one
+// index and one compare, and misses once the ring has moved past the tick.
+template <typename T, std::size_t MaxPlayers = BasicWorldState<T>::maxPlayers>
+class BasicWorldHistory {
+ public:
+  using Frame = BasicFlatWorldState<T, MaxPlayers>;
+
+  BasicWorldHistory(const BasicWorldHistory& other) = delete;
+  BasicWorldHistory& operator=(const BasicWorldHistory& other) = delete;
+
+  // Keeps the ticks `tickPeriod` apart that cover `depth` before the newest
+  // one, and that one.
+  BasicWorldHistory(const std::chrono::microseconds depth,
+                    const std::chrono::microseconds tickPeriod)
+      : slots_(TicksIn(depth, tickPeriod) + 1) {}
+
+  // Ticks are recorded in increasing order; recording a tick again after
+  // Truncate replaces what was kept for it.
+  void Record(const std::uint64_t tick, const BasicWorldState<T>& world) {
+    assert(!bHasTicks_ || tick > newest_);
+    Slot& slot = slots_[tick % slots_.size()];
+    slot.tick = tick;
+    slot.world.Assign(world);
+    oldest_ = bHasTicks_ ? std::max(oldest_, OldestWith(tick)) : tick;
+    newest_ = tick;
+    bHasTicks_ = true;
+  }
+
+  // The world at the end of `tick`, or null when it is not kept.
+  [[nodiscard]]
+  const Frame* Find(const std::uint64_t tick) const {
+    if (!Contains(tick)) return nullptr;
+    const Slot& slot = slots_[tick % slots_.size()];
+    return slot.tick == tick ? &slot.world : nullptr;
+  }
+
+  // Puts the world of `tick` into `world`; false, leaving it alone, when the
+  // tick is not kept.
+  [[nodiscard]]
+  bool Restore(const std::uint64_t tick, BasicWorldState<T>& world) const {
+    const Frame* frame = Find(tick);
+    if (!frame) return false;
+    frame->CopyTo(world);
+    return true;
+  }
+
+  // Forgets the ticks after `tick`, for a world restored to it that steps on
+  // from there.
+  void Truncate(const std::uint64_t tick) {
+    if (!bHasTicks_ || tick >= newest_) return;
+    if (tick < oldest_) {
+      bHasTicks_ = false;
+      return;
+    }
+    newest_ = tick;
+  }
+
+  [[nodiscard]]
+  bool Contains(const std::uint64_t tick) const {
+    return bHasTicks_ && tick >= oldest_ && tick <= newest_;
+  }
+
+  [[nodiscard]]
+  bool IsEmpty() const {
+    return !bHasTicks_;
+  }
+
+  // Only meaningful when not IsEmpty().
+  [[nodiscard]]
+  std::uint64_t OldestTick() const {
+    return oldest_;
+  }
+
+  [[nodiscard]]
+  std::uint64_t NewestTick() const {
+    return newest_;
+  }
+
+  [[nodiscard]]
+  std::size_t Capacity() const {
+    return slots_.size();
+  }
+
+ private:
+  struct Slot {
+    std::uint64_t tick{0};
+    Frame world{};
+  };
+
+  [[nodiscard]]
+  static std::size_t TicksIn(const std::chrono::microseconds depth,
+                             const std::chrono::microseconds tickPeriod) {
+    const auto period = std::max(tickPeriod, std::chrono::microseconds{1});
+    return static_cast<std::size_t>(
+        (std::max(depth, std::chrono::microseconds{0}) + period -
+         std::chrono::microseconds{1}) /
+        period);
+  }
+
+  // The oldest tick the ring can still hold once `tick` is in it.
+  [[nodiscard]]
+  std::uint64_t OldestWith(const std::uint64_t tick) const {
+    return tick < slots_.size() ? 0 : tick - slots_.size() + 1;
+  }
+
+  std::vector<Slot> slots_;
+  std::uint64_t oldest_{0};
+  std::uint64_t newest_{0};
+  bool bHasTicks_{false};
+};
+
+using WorldHistory = BasicWorldHistory<Real>;
+
+}  // namespace mp
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+
+#include "flat_world.hpp"
+#include "seqlock.hpp"
+
+namespace mp {
+
+// A tick's world, flat so that it can be shared between threads and
+// processes without pointers.
+template <std::size_t MaxPlayers>
+struct PublishedWorld {
+  std::uint64_t tick{0};
+  BasicFlatWorldState<Real, MaxPlayers> world{};
+
+  void Assign(const std::uint64_t currentTick, const WorldState& state) {
+    assert(state.players.size() <= MaxPlayers);
+    tick = currentTick;
+    world.Assign(state);
+  }
+
+  void CopyTo(WorldState& state) const { world.CopyTo(state); }
+};
+
+// The simulation publishes once per tick; metrics, recording or debug threads
+// take consistent snapshots without locking or stalling the tick.
+template <std::size_t MaxPlayers>
+class WorldPublisher {
+ public:
+  using Snapshot = PublishedWorld<MaxPlayers>;
+
+  void Publish(const std::uint64_t tick, const WorldState& world) {
+    staging_.Assign(tick, world);
+    seqlock_.Publish(staging_);
+  }
+
+  [[nodiscard]]
+  bool TryRead(Snapshot& out) const {
+    return seqlock_.TryRead(out);
+  }
+
+  void Read(Snapshot& out) const { seqlock_.Read(out); }
+
+  [[nodiscard]]
+  std::uint64_t Sequence() const {
+    return seqlock_.Sequence();
+  }
+
+ private:
+  Snapshot staging_{};
+  SeqLock<Snapshot> seqlock_;
+};
+
+}  // namespace mp